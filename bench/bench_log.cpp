@@ -0,0 +1,393 @@
+/*
+ RGPUtils
+ bench_log.cpp
+
+ Measures throughput (messages per second) and caller latency (p50, p99,
+ p99.9) of Log::print, Log::printv and Log::error for 1..N threads and
+ different outputs (stdout, a logfile and /dev/null), with and without ANSI
+ SGR codes on stdout.
+
+ Usage: bench_log [options]
+   --threads N       run with 1..N threads (default: 4)
+   --messages N      messages per thread and run (default: 100000)
+   --sinks LIST      comma separated list of stdout, file, null
+                     (default: file,null)
+   --file PATH       logfile used by the file sink (default: bench_log.log)
+   --format FORMAT   csv or json (default: csv)
+   --output PATH     write the results to this file instead of stderr
+
+ The results are written to stderr by default, so they don't get mixed with
+ the output of the stdout sink. The heap allocations done while logging are
+ counted as well, a steady-state log call should not allocate at all (only
+ the first calls of each thread may grow the reused buffers).
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include <rgp/Log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rgp;
+
+typedef std::chrono::steady_clock Clock;
+
+// counts all heap allocations of the process
+static std::atomic<uint64_t> allocations { 0 };
+
+void *operator new (size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void *memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete (void *memory) noexcept
+{
+    free(memory);
+}
+
+typedef enum : uint8_t {
+    MethodPrint = 0,
+    MethodPrintv,
+    MethodError
+} Method;
+
+typedef enum : uint8_t {
+    SinkStdout = 0,
+    SinkFile,
+    SinkNull
+} Sink;
+
+static const char *kMethodNames[] = { "print", "printv", "error" };
+static const char *kSinkNames[] = { "stdout", "file", "null" };
+
+struct Options {
+    unsigned int threads { 4 };
+    size_t messages { 100000 };
+    std::vector<Sink> sinks { SinkFile, SinkNull };
+    std::string file { "bench_log.log" };
+    bool json { false };
+    std::string output;
+};
+
+struct Result {
+    Method method;
+    Sink sink;
+    bool sgr;
+    unsigned int threads;
+    size_t messages;
+    double seconds;
+    double messagesPerSecond;
+    int64_t p50;
+    int64_t p99;
+    int64_t p999;
+    uint64_t allocations;
+};
+
+static bool parseSinks (const std::string &list, std::vector<Sink> &sinks)
+{
+    sinks.clear();
+
+    std::stringstream stream { list };
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (name == "stdout") {
+            sinks.push_back(SinkStdout);
+        } else if (name == "file") {
+            sinks.push_back(SinkFile);
+        } else if (name == "null") {
+            sinks.push_back(SinkNull);
+        } else {
+            return false;
+        }
+    }
+
+    return !sinks.empty();
+}
+
+static bool parseOptions (int argc, const char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++) {
+
+        std::string option { argv[i] };
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value { argv[++i] };
+
+        if (option == "--threads") {
+            options.threads = (unsigned int)std::max(1, atoi(value.c_str()));
+        } else if (option == "--messages") {
+            options.messages = (size_t)std::max(1, atoi(value.c_str()));
+        } else if (option == "--sinks") {
+            if (!parseSinks(value, options.sinks)) {
+                return false;
+            }
+        } else if (option == "--file") {
+            options.file = value;
+        } else if (option == "--format") {
+            if (value != "csv" && value != "json") {
+                return false;
+            }
+            options.json = value == "json";
+        } else if (option == "--output") {
+            options.output = value;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// points the outputs of the Log singleton to the sink
+static void useSink (const Sink sink, const Options &options)
+{
+    Log *log = Log::sharedLog();
+
+    // an empty path falls back to stdout / stderr
+    switch (sink) {
+        case SinkStdout: {
+            log->useLogfile("");
+            log->useErrorfile("");
+        } break;
+
+        case SinkFile: {
+            log->useLogfile(options.file);
+            log->useErrorfile(options.file);
+        } break;
+
+        case SinkNull: {
+            log->useLogfile("/dev/null");
+            log->useErrorfile("/dev/null");
+        } break;
+    }
+}
+
+static void logMessage (const Method method, const std::string &message)
+{
+    Log *log = Log::sharedLog();
+
+    switch (method) {
+        case MethodPrint: {
+            log->print(message, AnsiSgrFgColorGreen);
+        } break;
+
+        case MethodPrintv: {
+            log->printv(message, AnsiSgrFgColorGreen);
+        } break;
+
+        case MethodError: {
+            log->error(message);
+        } break;
+    }
+}
+
+static int64_t percentile (const std::vector<int64_t> &sorted, const double p)
+{
+    size_t index = (size_t)(p * (double)(sorted.size() - 1));
+    return sorted[index];
+}
+
+static Result run (const Method method, const Sink sink, const bool sgr,
+                   const unsigned int threads, const size_t messages)
+{
+    const std::string message { "benchmark message with a typical length of "
+                                "about eighty characters" };
+
+    std::vector<std::vector<int64_t>> latencies(threads);
+    std::atomic<unsigned int> ready { 0 };
+    std::atomic<bool> start { false };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+
+            std::vector<int64_t> &samples = latencies[t];
+            samples.resize(messages);
+
+            // start all threads at the same time
+            ready++;
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+
+            for (size_t i = 0; i < messages; i++) {
+                Clock::time_point before = Clock::now();
+                logMessage(method, message);
+                samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - before).count();
+            }
+        });
+    }
+
+    while (ready.load() < threads) {
+        std::this_thread::yield();
+    }
+
+    uint64_t allocationsBefore = allocations.load();
+    Clock::time_point begin = Clock::now();
+    start = true;
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    uint64_t allocationsAfter = allocations.load();
+    Log::sharedLog()->flush();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::vector<int64_t> all;
+    all.reserve(threads * messages);
+    for (auto &samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    Result result;
+    result.method = method;
+    result.sink = sink;
+    result.sgr = sgr;
+    result.threads = threads;
+    result.messages = all.size();
+    result.seconds = seconds;
+    result.messagesPerSecond = (double)all.size() / seconds;
+    result.p50 = percentile(all, 0.5);
+    result.p99 = percentile(all, 0.99);
+    result.p999 = percentile(all, 0.999);
+    result.allocations = allocationsAfter - allocationsBefore;
+
+    return result;
+}
+
+static void writeResults (std::ostream &stream, const std::vector<Result> &results,
+                          const bool json)
+{
+    if (json) {
+        stream << "[\n";
+    } else {
+        stream << "method,sink,sgr,threads,messages,seconds,"
+                  "messages_per_second,p50_ns,p99_ns,p999_ns,allocations\n";
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+
+        const Result &r = results[i];
+
+        if (json) {
+            stream << "  {\"method\": \"" << kMethodNames[r.method] << "\""
+                   << ", \"sink\": \"" << kSinkNames[r.sink] << "\""
+                   << ", \"sgr\": " << (r.sgr ? "true" : "false")
+                   << ", \"threads\": " << r.threads
+                   << ", \"messages\": " << r.messages
+                   << ", \"seconds\": " << r.seconds
+                   << ", \"messages_per_second\": " << (uint64_t)r.messagesPerSecond
+                   << ", \"p50_ns\": " << r.p50
+                   << ", \"p99_ns\": " << r.p99
+                   << ", \"p999_ns\": " << r.p999
+                   << ", \"allocations\": " << r.allocations
+                   << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        } else {
+            stream << kMethodNames[r.method] << ','
+                   << kSinkNames[r.sink] << ','
+                   << (r.sgr ? 1 : 0) << ','
+                   << r.threads << ','
+                   << r.messages << ','
+                   << r.seconds << ','
+                   << (uint64_t)r.messagesPerSecond << ','
+                   << r.p50 << ','
+                   << r.p99 << ','
+                   << r.p999 << ','
+                   << r.allocations << '\n';
+        }
+    }
+
+    if (json) {
+        stream << "]\n";
+    }
+}
+
+int main (int argc, const char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " [--threads N] [--messages N]"
+                     " [--sinks stdout,file,null] [--file PATH]"
+                     " [--format csv|json] [--output PATH]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Log *log = Log::sharedLog();
+
+    // printv is only written with the verbose loglevel
+    log->setLoglevel(LoglevelVerbose);
+
+    std::vector<Result> results;
+
+    for (Sink sink : options.sinks) {
+
+        useSink(sink, options);
+
+        // SGR codes are only written to stdout
+        for (int sgr = 0; sgr < (sink == SinkStdout ? 2 : 1); sgr++) {
+
+            log->setUseAnsiSgrCodes(sgr == 1);
+
+            for (int method = MethodPrint; method <= MethodError; method++) {
+                for (unsigned int threads = 1; threads <= options.threads; threads++) {
+                    results.push_back(run((Method)method, sink, sgr == 1,
+                                          threads, options.messages));
+                }
+            }
+        }
+    }
+
+    useSink(SinkStdout, options);
+
+    if (options.output.empty()) {
+        writeResults(std::cerr, results, options.json);
+        return EXIT_SUCCESS;
+    }
+
+    std::ofstream output { options.output };
+    if (!output.is_open()) {
+        std::cerr << "can't open " << options.output << std::endl;
+        return EXIT_FAILURE;
+    }
+    writeResults(output, results, options.json);
+
+    return EXIT_SUCCESS;
+}
@@ -49,6 +49,11 @@ int main (int argc, const char **argv)
     logout << "another method " << 42 << std::endl;
     Log::sharedLog()->print(logout.str());
     
+    // format string version (only in debug mode), can be written to a binary
+    // logfile with Log::sharedLog()->useBinaryLogfile("log.bin") and decoded
+    // later with the rgplog-decode tool
+    RGPLOG_FMT("the answer is {} (and pi is about {})", 42, 3.14);
+    
     Log::sharedLog()->printv("logout on verbose mode ... not set yet => this" \
         "won't be printed");
 
@@ -65,6 +70,22 @@ int main (int argc, const char **argv)
     RGPLOGV("This will only be logged if compiled in debug mode and logging " \
             "is on verbose");
     
+    // structured record with typed fields (logfmt by default, JSON with
+    // setStructuredFormat(LogStructuredFormatJson))
+    Log::sharedLog()->log(LoglevelInfo, "example started",
+                          {{"args", argc}, {"name", argv[0]}});
+    
+    // a category has its own loglevel, f.e. to get details of a single
+    // subsystem ("[net] connected to example.com:443")
+    LogCategory &net = Log::sharedLog()->category("net");
+    net.setLoglevel(LoglevelTrace);
+    net.log(LoglevelTrace, "connected to {}:{}", "example.com", 443);
+    
+    // let a background thread do the writing
+    Log::sharedLog()->setUseAsyncMode(true);
+    Log::sharedLog()->print("This text is written by the writer thread");
+    Log::sharedLog()->flush();
+    
     // getline will get the input from the user
     std::string yourName = Log::sharedLog()->getline("What is your name?: ");
     
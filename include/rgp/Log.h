@@ -33,6 +33,14 @@
 #include <mutex>
 #include <atomic>
 #include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <condition_variable>
+#include <initializer_list>
+#include <type_traits>
+
+#include <rgp/LogFormat.h>
 
 // on windows we need the exports for creating the dll
 #if defined(_WIN32)
@@ -45,54 +53,129 @@
  #define RGPUTILS_EXPORT
 #endif
 
+// numeric loglevels for the preprocessor (same values as rgp::Loglevel)
+#define RGP_LOGLEVEL_OFF 0
+#define RGP_LOGLEVEL_ERROR 1
+#define RGP_LOGLEVEL_WARNING 2
+#define RGP_LOGLEVEL_INFO 3
+#define RGP_LOGLEVEL_DEBUG 4
+#define RGP_LOGLEVEL_TRACE 5
+
 // hide debug information (and string data) for better security
 // (less information for an attacker)
+// RGP_LOG_COMPILE_LEVEL decides which RGPLOG* macros are compiled in. Calls
+// of a more detailed level expand to nothing (the arguments are not even
+// evaluated). Without DEBUG nothing is compiled in by default, define f.e.
+// RGP_LOG_COMPILE_LEVEL=RGP_LOGLEVEL_INFO to keep errors, warnings and normal
+// logs in release builds.
+#ifndef RGP_LOG_COMPILE_LEVEL
 #ifdef DEBUG
-#define RGPLOG(xx) rgp::Log::sharedLog()->print(xx)
+#define RGP_LOG_COMPILE_LEVEL RGP_LOGLEVEL_TRACE
 #else
-#define RGPLOG(xx) ((void)0)
+#define RGP_LOG_COMPILE_LEVEL RGP_LOGLEVEL_OFF
 #endif // DEBUG
+#endif // RGP_LOG_COMPILE_LEVEL
 
-// hide debug information (and string data) for better security
-// (less information for an attacker)
-// verbose version of RGPLOG
-#ifdef DEBUG
-#define RGPLOGV(xx) rgp::Log::sharedLog()->printv(xx)
+// logs a format string with arguments through a static call site
+// (every call site gets its own format id for binary logfiles)
+#define RGPLOG_SITE_(level, ...) do { \
+    static rgp::LogSite rgpLogSite; \
+    rgp::Log::sharedLog()->log(rgpLogSite, level, __VA_ARGS__); \
+} while (0)
+
+// errors
+#if RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_ERROR
+#define RGPLOG_ERROR(xx) rgp::Log::sharedLog()->error(xx)
+#define RGPLOG_ERRNO(xx,yy) rgp::Log::sharedLog()->errorWithErrno(xx, yy)
+#define RGPLOG_ERROR_FMT(...) RGPLOG_SITE_(rgp::LoglevelError, __VA_ARGS__)
 #else
-#define RGPLOGV(xx) ((void)0)
-#endif // DEBUG
+#define RGPLOG_ERROR(xx) ((void)0)
+#define RGPLOG_ERRNO(xx,yy) ((void)0)
+#define RGPLOG_ERROR_FMT(...) ((void)0)
+#endif // RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_ERROR
 
-// hide debug information (and function name) for better security
-// (less information for an attacker)
-#ifdef DEBUG
+// warnings
+#if RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_WARNING
+#define RGPLOG_WARNING(xx) rgp::Log::sharedLog()->log(rgp::LoglevelWarning, xx)
+#define RGPLOG_WARNING_FMT(...) RGPLOG_SITE_(rgp::LoglevelWarning, __VA_ARGS__)
+#else
+#define RGPLOG_WARNING(xx) ((void)0)
+#define RGPLOG_WARNING_FMT(...) ((void)0)
+#endif // RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_WARNING
+
+// normal logs (RGPLOG_INFO is the same as RGPLOG)
+#if RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_INFO
+#define RGPLOG(xx) rgp::Log::sharedLog()->print(xx)
+#define RGPLOG_FMT(...) RGPLOG_SITE_(rgp::LoglevelInfo, __VA_ARGS__)
 #define RGPLOGMETHODNAME() RGPLOG(__PRETTY_FUNCTION__)
 #else
+#define RGPLOG(xx) ((void)0)
+#define RGPLOG_FMT(...) ((void)0)
 #define RGPLOGMETHODNAME() ((void)0)
-#endif // DEBUG
+#endif // RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_INFO
+#define RGPLOG_INFO(xx) RGPLOG(xx)
+#define RGPLOG_INFO_FMT(...) RGPLOG_FMT(__VA_ARGS__)
 
-// log errno
-#ifdef DEBUG
-#define RGPLOG_ERRNO(xx,yy) rgp::Log::sharedLog()->errorWithErrno(xx, yy)
+// verbose logs (RGPLOG_DEBUG is the same as RGPLOGV)
+#if RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_DEBUG
+#define RGPLOGV(xx) rgp::Log::sharedLog()->printv(xx)
+#define RGPLOGV_FMT(...) RGPLOG_SITE_(rgp::LoglevelDebug, __VA_ARGS__)
 #else
-#define RGPLOG_ERRNO(xx,yy) ((void)0)
-#endif // DEBUG
+#define RGPLOGV(xx) ((void)0)
+#define RGPLOGV_FMT(...) ((void)0)
+#endif // RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_DEBUG
+#define RGPLOG_DEBUG(xx) RGPLOGV(xx)
+#define RGPLOG_DEBUG_FMT(...) RGPLOGV_FMT(__VA_ARGS__)
 
-#ifdef DEBUG
-#define RGPLOG_ERROR(xx) rgp::Log::sharedLog()->error(xx)
+// the most detailed logs
+#if RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_TRACE
+#define RGPLOG_TRACE(xx) rgp::Log::sharedLog()->log(rgp::LoglevelTrace, xx)
+#define RGPLOG_TRACE_FMT(...) RGPLOG_SITE_(rgp::LoglevelTrace, __VA_ARGS__)
 #else
-#define RGPLOG_ERROR(xx) ((void)0)
-#endif // DEBUG
+#define RGPLOG_TRACE(xx) ((void)0)
+#define RGPLOG_TRACE_FMT(...) ((void)0)
+#endif // RGP_LOG_COMPILE_LEVEL >= RGP_LOGLEVEL_TRACE
 
 namespace rgp {
     
-    /** Describes a Loglevel. */
+    struct LogRecord;
+    struct LogThreadBuffer;
+    struct LogThreadBufferHolder;
+    class LogCompressor;
+    class LogFile;
+    class LogMappedFile;
+    class LogUringFile;
+    class LogSink;
+    class LogCategory;
+    class LogSampler;
+    class LogFlightRecorder;
+    class LogHistogram;
+    struct LogMetrics;
+    struct LogConfigSnapshot;
+    class LogConfigRef;
+    template <typename T> class LogRingBuffer;
+    
+    /** Describes a Loglevel. A loglevel includes all levels below it. */
     typedef enum : uint8_t {
-        /** Turns logging off. Nothing will be outputted. */
-        LoglevelOff = 0,
-        /** Turns on output for normal logs. */
-        LoglevelNormal,
-        /** Verbose mode. Typically used for more detailed logs. */
-        LoglevelVerbose
+        /** Turns logging off. Only errors of the Log (f.e. error()) are
+         still outputted, categories output nothing. */
+        LoglevelOff = RGP_LOGLEVEL_OFF,
+        /** Only errors. */
+        LoglevelError = RGP_LOGLEVEL_ERROR,
+        /** Warnings, something unexpected that could be handled. */
+        LoglevelWarning = RGP_LOGLEVEL_WARNING,
+        /** Informational messages. */
+        LoglevelInfo = RGP_LOGLEVEL_INFO,
+        /** Turns on output for normal logs (same as LoglevelInfo, the value
+         was 1 before version 2.0). */
+        LoglevelNormal = LoglevelInfo,
+        /** Debug messages. */
+        LoglevelDebug = RGP_LOGLEVEL_DEBUG,
+        /** Verbose mode. Typically used for more detailed logs
+         (same as LoglevelDebug, the value was 2 before version 2.0). */
+        LoglevelVerbose = LoglevelDebug,
+        /** Very detailed messages, f.e. to trace the program flow. */
+        LoglevelTrace = RGP_LOGLEVEL_TRACE
     } Loglevel;
     
     /** Describes a ANSI Foregorund Color used for
@@ -141,6 +224,208 @@ namespace rgp {
         AnsiSgrBgColorWhite
     } AnsiSgrBgColor;
     
+    /** Describes the precision of the time written in front of every line of
+     a logfile. */
+    typedef enum : uint8_t {
+        /** Full seconds (f.e. 2014-7-8 13:5:42). */
+        LogTimestampPrecisionSeconds = 0,
+        /** Milliseconds (f.e. 2014-7-8 13:5:42.123). */
+        LogTimestampPrecisionMilliseconds,
+        /** Microseconds (f.e. 2014-7-8 13:5:42.123456). */
+        LogTimestampPrecisionMicroseconds
+    } LogTimestampPrecision;
+    
+    /**
+     @brief Describes what happens when the queue of the asynchronous mode
+     is full.
+     @details Errors are never dropped. A message that is kept makes space by
+     dropping the oldest queued messages the policy allows to drop, if the
+     oldest message must be kept it waits for the writer thread. The order
+     of the kept messages never changes.
+     */
+    typedef enum : uint8_t {
+        /** Wait until the writer thread made space (default). */
+        LogOverflowPolicyBlock = 0,
+        /** Drop the message that doesn't fit into the queue. */
+        LogOverflowPolicyDropNewest,
+        /** Drop the oldest message in the queue to make space. */
+        LogOverflowPolicyDropOldest,
+        /** Drop messages more detailed than a level, the others only drop
+         queued messages more detailed than the level. */
+        LogOverflowPolicyDropBelowLevel
+    } LogOverflowPolicy;
+    
+    /**
+     @brief Describes when written logfile data is synchronized to the disk.
+     @details Uses fdatasync() (fsync() on Mac OS X, _commit() on Windows)
+     after the buffer was written, so the cost is paid once per write of the
+     buffer and not per line.
+     */
+    typedef enum : uint8_t {
+        /** Leave it to the operating system (default). */
+        LogSyncPolicyNone = 0,
+        /** Synchronize after writing a buffer that contains an error. */
+        LogSyncPolicyError,
+        /** Synchronize after every write of the buffer. */
+        LogSyncPolicyAlways
+    } LogSyncPolicy;
+    
+    /**
+     @brief Describes when buffered output is written to the logfiles.
+     @details The logfiles stay open while they are used. Output is collected
+     in a buffer which will be written to the file if one of the conditions
+     is met. The default policy writes every message immediately. In
+     asynchronous mode the writer thread collects all lines of a batch and
+     writes them together (group commit), the conditions are checked once
+     per batch.
+     */
+    struct RGPUTILS_EXPORT LogFlushPolicy {
+        
+        LogFlushPolicy (const size_t bufferSize = 0,
+                        const unsigned int interval = 0,
+                        const bool flushOnError = true,
+                        const LogSyncPolicy sync = LogSyncPolicyNone)
+        : bufferSize(bufferSize), interval(interval), flushOnError(flushOnError),
+          sync(sync)
+        {};
+        
+        /** Write the buffer when it holds at least this many bytes.
+         0 writes every message immediately. */
+        size_t bufferSize;
+        
+        /** Write the buffer at least every interval milliseconds.
+         0 disables time based writing. */
+        unsigned int interval;
+        
+        /** Write the buffer of the errorfile immediately after an error was
+         logged. */
+        bool flushOnError;
+        
+        /** When written data is synchronized to the disk. */
+        LogSyncPolicy sync;
+    };
+    
+    /**
+     @brief Describes when a logfile is replaced by a new one.
+     @details On rotation the current logfile is renamed to
+     "<path>.<year><month><day>-<hour><minute><second>" and a new file is
+     started at the original path. The rotated file can be compressed in a
+     background thread. By default logfiles are never rotated.
+     */
+    struct RGPUTILS_EXPORT LogRotationPolicy {
+        
+        LogRotationPolicy (const uint64_t maxSize = 0,
+                           const unsigned int interval = 0,
+                           const bool compress = true)
+        : maxSize(maxSize), interval(interval), compress(compress)
+        {};
+        
+        /** Rotate when the logfile reached this size in bytes (checked after
+         each write of the buffer). 0 disables size based rotation. */
+        uint64_t maxSize;
+        
+        /** Rotate every interval seconds, aligned to the epoch (f.e. 3600
+         rotates at every full hour UTC). 0 disables time based rotation. */
+        unsigned int interval;
+        
+        /** Compress rotated files with gzip ("<rotated path>.gz"). Only
+         available if the library was built with zlib. */
+        bool compress;
+    };
+    
+    /**
+     @brief Limits how often a single call site is written.
+     @details Applies to the call sites of the RGPLOG*_FMT macros and to
+     messages logged without one: messages logged as text (f.e. print() or
+     error() with a string) are grouped by their text, format strings with
+     arguments (f.e. print("{} of {}", i, n)) by the format string, into 256
+     shared call sites. Messages of a LogCategory are grouped separately from
+     the same text or format string of other categories. Each call site has its
+     own token bucket which holds up to burst messages and is refilled with
+     messagesPerSecond. Messages of an empty bucket are dropped and counted,
+     the count is written as "N messages suppressed by the rate limit" before
+     the next message of the call site. A message with the same arguments
+     (or text) as the last one of its call site is dropped within
+     duplicateInterval and written as "last message repeated N times" before
+     the next different message (or the same one after the interval). If no
+     message of the call site follows, the summaries are written about once
+     per second, by flush() and by shutdown(). By default nothing is limited.
+     */
+    struct RGPUTILS_EXPORT LogRateLimit {
+        
+        LogRateLimit (const double messagesPerSecond = 0,
+                      const unsigned int burst = 10,
+                      const unsigned int duplicateInterval = 0)
+        : messagesPerSecond(messagesPerSecond), burst(burst),
+          duplicateInterval(duplicateInterval)
+        {};
+        
+        /** Messages per second and call site. 0 disables the token bucket. */
+        double messagesPerSecond;
+        
+        /** Messages a call site may write at once after being idle. */
+        unsigned int burst;
+        
+        /** Collapse repeated messages of a call site for this many
+         milliseconds. 0 disables the duplicate suppression. */
+        unsigned int duplicateInterval;
+    };
+    
+    /**
+     @brief Describes which debug and trace messages are kept.
+     @details Sampling keeps a representative part of the verbose output
+     (LoglevelDebug and LoglevelTrace, f.e. printv()). Only 1 of every
+     messages is kept, each of them with the given probability. The decision
+     is taken before the message is formatted. By default all messages are
+     kept.
+     */
+    struct RGPUTILS_EXPORT LogSamplingPolicy {
+        
+        LogSamplingPolicy (const unsigned int every = 1,
+                           const double probability = 1.0)
+        : every(every), probability(probability)
+        {};
+        
+        /** Keep 1 of every messages (counted over all threads). 0 and 1 keep
+         every message. */
+        unsigned int every;
+        
+        /** Probability of keeping a message (0.0 - 1.0). */
+        double probability;
+    };
+    
+    /**
+     @brief Describes the flight recorder of the Log.
+     @details The flight recorder keeps the most recent lines of every
+     thread in memory, independent of the loglevel, and writes them out only
+     when something went wrong. By default it is disabled.
+     */
+    struct RGPUTILS_EXPORT LogFlightRecorderPolicy {
+        
+        LogFlightRecorderPolicy (const size_t bufferSize = 0,
+                                 const Loglevel level = LoglevelTrace,
+                                 const bool dumpOnError = true,
+                                 const bool dumpOnSignal = false)
+        : bufferSize(bufferSize), level(level), dumpOnError(dumpOnError),
+          dumpOnSignal(dumpOnSignal)
+        {};
+        
+        /** Size of the circular buffer of each thread in bytes, the oldest
+         lines are overwritten. 0 disables the flight recorder. */
+        size_t bufferSize;
+        
+        /** The most detailed level that is recorded. */
+        Loglevel level;
+        
+        /** Write all buffers when an error is logged. */
+        bool dumpOnError;
+        
+        /** Write all buffers when the process receives a fatal signal
+         (SIGSEGV, SIGBUS, SIGFPE, SIGILL or SIGABRT). Not available on
+         Windows. */
+        bool dumpOnSignal;
+    };
+    
     /**
      @brief A Singleton Log class for thread-safe logging
      @details This class uses std::cout / std::cerr for log and error outputs.
@@ -152,11 +437,35 @@ namespace rgp {
         /** 
          @brief The Log class is build as a singleton.
          @details There is only one instance at a time. This method will give you this instance.
-         On first call this will create the singleton instance.
+         On first call this will create the singleton instance (exactly once,
+         even if several threads call it at the same time) and registers
+         shutdown() to be called at exit.
          @return The shared log object.
          */
         static Log *sharedLog ();
         
+        /**
+         @brief Writes everything that is buffered or queued and stops the
+         background threads.
+         @details Hands over the per-thread buffers, lets the writer thread of
+         the asynchronous mode drain its queue, writes the buffers of the
+         logfiles and sinks, waits for the compression of rotated logfiles and
+         closes the memory mapped logfile. The Log stays usable: messages
+         logged afterwards are written directly (without the asynchronous
+         mode, the flush thread and the memory mapped logfile until they are
+         enabled again). Called at exit with the default timeout, so
+         aggressive buffering doesn't lose the last messages.
+         @param timeout Maximum time in milliseconds to wait for the writer
+         thread and the compression (0 waits as long as it takes). A writer
+         thread that didn't finish in time is left running with the outputs,
+         they aren't flushed then and the asynchronous mode can't be enabled
+         again until it finished.
+         @return True if everything was written within the timeout (also if
+         the Log was never used).
+         @sa flush()
+         */
+        static bool shutdown (const unsigned int timeout = 5000);
+        
         /**
          @brief The current LogLevel (Default: LoglevelNormal).
          @return The current LogLevel.
@@ -169,11 +478,153 @@ namespace rgp {
          @details The loglevel describes how detailed the output should be.
          This will affect output to logfiles in the same way.
          Input methods like getline or getc will be unaffected.
+         Categories without an own loglevel follow this loglevel.
          @param level The new loglevel.
-         @sa loglevel(), print() and printv()
+         @sa loglevel(), print(), printv() and category()
          */
         void setLoglevel (const Loglevel level);
         
+        /**
+         @brief Gives the handle of a named category (f.e. "net" or "db").
+         @details The category is created on first use and exists as long as
+         the Log, so the handle should be obtained once and kept. Each
+         category has its own loglevel which follows the loglevel of the Log
+         until it is set for the category.
+         @param name The name of the category. It is written in front of
+         every message of the category.
+         @return The category.
+         @sa LogCategory
+         */
+        LogCategory &category (const std::string &name);
+        
+        /**
+         @brief Determines if messages of the given level will be logged.
+         @details Only loads the current loglevel, can be used to skip
+         expensive preparations of log messages. Errors are logged with every
+         loglevel (also LoglevelOff).
+         @param level The level of a message.
+         @return True if messages of this level are logged, false otherwise.
+         @sa loglevel()
+         */
+        bool isEnabled (const Loglevel level) const {
+            return level != LoglevelOff &&
+                   (level == LoglevelError ||
+                    _logLevel.load(std::memory_order_relaxed) >= level);
+        };
+        
+        /**
+         @brief Sets which debug and trace messages are kept.
+         @details Applies to the Log and to all categories without an own
+         sampling policy. Messages that are dropped by the sampling are
+         never formatted.
+         @param policy The new sampling policy.
+         @sa samplingPolicy() and LogSamplingPolicy
+         */
+        void setSamplingPolicy (const LogSamplingPolicy &policy);
+        
+        /**
+         @brief The current sampling policy.
+         @return The current sampling policy.
+         @sa setSamplingPolicy()
+         */
+        LogSamplingPolicy samplingPolicy () const;
+        
+        /**
+         @brief This will logout the given text with the given level.
+         @details The text is only logged if the current loglevel includes
+         the given level. LoglevelError goes to std::cerr / the errorfile
+         (like error()), all other levels go to std::cout / the logfile.
+         @param level The level of the message (not LoglevelOff).
+         @param text The text that should be logged out.
+         @param fgcolor The foreground color of the text (only for supported
+         terminals). This parameter is optional.
+         @param bgcolor The background color of the text (only for supported
+         terminals). This parameter is optional.
+         @sa isEnabled(), print() and error()
+         */
+        void log (const Loglevel level, const LogStringRef text,
+                  const AnsiSgrFgColor fgcolor = AnsiSgrFgColorDefault,
+                  const AnsiSgrBgColor bgcolor = AnsiSgrBgColorDefault);
+        
+        /**
+         @brief Logs a format string with arguments with the given level.
+         @details Same as print(const char *, ...) with a level.
+         @sa log() and print()
+         */
+        template <typename Arg, typename... Args>
+        typename std::enable_if<!std::is_same<Arg, AnsiSgrFgColor>::value>::type
+        log (const Loglevel level, const char *format, const Arg &arg,
+             const Args &... args)
+        {
+            bool output = isEnabled(level) && isSampled(level, *_sampler);
+            if (output || isRecorded(level)) {
+                const LogArgument arguments[] = { arg, args... };
+                logFormat(level, output, format, arguments, 1 + sizeof...(Args));
+            }
+        };
+        
+        /**
+         @brief Logs a format string with arguments for a call site with the
+         given level.
+         @details Same as print(LogSite &, ...) with a level. Usually called
+         through the RGPLOG*_FMT macros.
+         @sa log() and print()
+         */
+        template <typename... Args>
+        void log (LogSite &site, const Loglevel level, const char *format,
+                  const Args &... args)
+        {
+            bool output = isEnabled(level) && isSampled(level, *_sampler);
+            if (output || isRecorded(level)) {
+                const LogArgument arguments[] = { LogArgument(), args... };
+                logSite(site, level, output, format, arguments + 1,
+                        sizeof...(Args));
+            }
+        };
+        
+        /**
+         @brief Logs a message with typed fields as a structured record.
+         @details The record is encoded as logfmt or JSON (see
+         setStructuredFormat()) with the fields "ts" (UTC), "level" and "msg"
+         in front of the given fields. Lines of structured records get no
+         additional timestamp, so logfiles can be parsed line by line.
+         Example:
+         log(LoglevelInfo, "request done", {{"status", 200}, {"path", path}});
+         @param level The level of the record (not LoglevelOff).
+         @param message The message.
+         @param fields The fields.
+         @sa setStructuredFormat() and LogField
+         */
+        void log (const Loglevel level, const char *message,
+                  std::initializer_list<LogField> fields);
+        
+        /**
+         @brief Logs a message with typed fields as a structured record.
+         @details Same as log(const Loglevel, const char *,
+         std::initializer_list<LogField>) for a number of fields only known at
+         runtime.
+         @param level The level of the record (not LoglevelOff).
+         @param message The message.
+         @param fields The fields.
+         @param count Number of fields.
+         */
+        void log (const Loglevel level, const char *message,
+                  const LogField *fields, const size_t count);
+        
+        /**
+         @brief Sets the encoding of structured records.
+         @param format The encoding (LogStructuredFormatLogfmt by default).
+         @sa structuredFormat()
+         */
+        void setStructuredFormat (const LogStructuredFormat format);
+        
+        /**
+         @brief The encoding of structured records.
+         @return The encoding.
+         @sa setStructuredFormat()
+         */
+        LogStructuredFormat structuredFormat () const;
+        
         /**
          @brief This will logout the given text.
          @details The given text will be printed to std::cout if the required
@@ -186,7 +637,7 @@ namespace rgp {
          terminals). This parameter is optional.
          @sa loglevel() and useLogfile()
          */
-        void print (const std::string text,
+        void print (const LogStringRef text,
                     const AnsiSgrFgColor fgcolor=AnsiSgrFgColorDefault,
                     const AnsiSgrBgColor bgcolor=AnsiSgrBgColorDefault);
         
@@ -202,18 +653,108 @@ namespace rgp {
          terminals). This parameter is optional.
          @sa loglevel() and useLogfile()
          */
-        void printv (const std::string text,
+        void printv (const LogStringRef text,
                      const AnsiSgrFgColor fgcolor = AnsiSgrFgColorDefault,
                      const AnsiSgrBgColor bgcolor = AnsiSgrBgColorDefault);
         
+        /**
+         @brief Logs a format string with arguments.
+         @details The loglevel is checked first, the text will only be
+         created if it will really be logged. Every "{}" in the format string
+         is replaced by the next argument (see LogFormat.h), f.e.
+         print("connected to {}:{}", host, port). Numbers are converted
+         without iostreams.
+         @param format The format string.
+         @param arg The first argument.
+         @param args The remaining arguments.
+         @sa print() and printv()
+         */
+        template <typename Arg, typename... Args>
+        typename std::enable_if<!std::is_same<Arg, AnsiSgrFgColor>::value>::type
+        print (const char *format, const Arg &arg, const Args &... args)
+        {
+            log(LoglevelNormal, format, arg, args...);
+        };
+        
+        /**
+         @brief Logs a format string with arguments in verbose mode.
+         @details Same as print(const char *, ...) but requires
+         LoglevelVerbose. If the loglevel is lower, this costs only the check
+         of the loglevel.
+         @sa print()
+         */
+        template <typename Arg, typename... Args>
+        typename std::enable_if<!std::is_same<Arg, AnsiSgrFgColor>::value>::type
+        printv (const char *format, const Arg &arg, const Args &... args)
+        {
+            log(LoglevelVerbose, format, arg, args...);
+        };
+        
+        /**
+         @brief Logs an error from a format string with arguments.
+         @details Same as print(const char *, ...) but for error().
+         @sa error()
+         */
+        template <typename Arg, typename... Args>
+        void error (const char *format, const Arg &arg, const Args &... args)
+        {
+            log(LoglevelError, format, arg, args...);
+        };
+        
+        /**
+         @brief Logs a format string with arguments for a call site.
+         @details Same as print() but the text will be created from the
+         format string and the arguments (see LogFormat.h). If a binary
+         logfile is used, only the format id of the call site and the
+         arguments are written to it and the text is never created. Usually
+         called through the RGPLOG_FMT macro.
+         @param site The call site (a static variable at the call site).
+         @param format The format string. The first format string given for
+         a site will be used for all following calls.
+         @param args The arguments.
+         @sa useBinaryLogfile()
+         */
+        template <typename... Args>
+        void print (LogSite &site, const char *format, const Args &... args)
+        {
+            log(site, LoglevelNormal, format, args...);
+        };
+        
+        /**
+         @brief Logs a format string with arguments for a call site.
+         @details Same as print(LogSite &, ...) but requires LoglevelVerbose.
+         Usually called through the RGPLOGV_FMT macro.
+         @sa print()
+         */
+        template <typename... Args>
+        void printv (LogSite &site, const char *format, const Args &... args)
+        {
+            log(site, LoglevelVerbose, format, args...);
+        };
+        
+        /**
+         @brief Logs an error from a format string with arguments.
+         @details Same as print(LogSite &, ...) but for error(). Usually
+         called through the RGPLOG_ERROR_FMT macro.
+         @sa error()
+         */
+        template <typename... Args>
+        void error (LogSite &site, const char *format, const Args &... args)
+        {
+            log(site, LoglevelError, format, args...);
+        };
+        
         /**
          @brief Read a line from std::cin.
          @details Shows a given text and wait's on std::cin till the user gave
-         some input. All output through std::cout will be blocked until this
-         method returns. Output to std::cerr will still be shown.
+         some input. Other threads keep logging while waiting: their output
+         to std::cout is held back and shown after the input (very much
+         output is shown right away), output to std::cerr and to files is
+         written as usual. Only one prompt is shown at a time.
          @param text The text that will be shown before the user can input his
          text.
-         @return The input from std::cin. The input will be a whole line.
+         @return The input from std::cin. The input will be a whole line of
+         any length (without the newline).
          @sa getc()
          */
         std::string getline (const std::string text);
@@ -221,8 +762,8 @@ namespace rgp {
         /**
          @brief Read a character from std::cin.
          @details Shows a given text and wait's on std::cin till the user gave
-         his input. All output through std::cout will be blocked until this
-         method returns. Output to std::cerr will still be shown.
+         his input. Other threads keep logging while waiting, output to
+         std::cout is held back like with getline().
          @param text The text that will be shown before the user can input a
          character.
          @return The input from std::cin. The input just be a character.
@@ -232,12 +773,13 @@ namespace rgp {
         
         /**
          @brief This will logout the given text.
-         @details The given text will be printed to std::cerr. If there is a
-         errorfile specified, the output will be written to that file instead.
+         @details The given text will be printed to std::cerr (with every
+         loglevel, also LoglevelOff). If there is a errorfile specified, the
+         output will be written to that file instead.
          @param text The text that should be logged out.
          @sa errorWithErrno() and useErrorfile()
          */
-        void error (const std::string text);
+        void error (const LogStringRef text);
         
         /**
          @brief This will logout the given text with the given errno code.
@@ -249,7 +791,7 @@ namespace rgp {
          error text.
          @sa error() and useErrorfile()
          */
-        void errorWithErrno (const std::string text, const int err);
+        void errorWithErrno (const LogStringRef text, const int err);
         
         /**
          @brief Set logfile for output.
@@ -270,14 +812,201 @@ namespace rgp {
          @sa useLogfile()
          */
         void useErrorfile (const std::string filePath);
+        
+        /**
+         @brief Set a binary logfile for format string logging.
+         @details While a binary logfile is set, all messages logged through
+         a call site (f.e. with the RGPLOG_FMT macros) are written to this
+         file in a compact binary form: the id of the format string plus the
+         raw arguments. The text will be created later by the rgplog-decode
+         tool. Other messages are not affected.
+         @param filePath The path to the file that should be used.
+         An empty path stops writing the binary logfile.
+         @sa print(LogSite &, ...)
+         */
+        void useBinaryLogfile (const std::string filePath);
+        
+        /**
+         @brief Set a memory mapped logfile for print.
+         @details Used instead of the logfile for normal output. The file is
+         split into segments ("<filePath>.0", "<filePath>.1", ...) of
+         segmentSize bytes, which are preallocated and mapped into memory.
+         Each line is copied into the mapping without a system call or a
+         lock, so logging costs about as much as a memcpy, and everything
+         logged survives a crash of the process. A full segment is truncated
+         to its used size and the next one is started. The last segment of a
+         crashed process ends with zero bytes. Not available on Windows.
+         @param filePath The base path of the segments. An empty path stops
+         writing the memory mapped logfile.
+         @param segmentSize The size of each segment in bytes.
+         @throw LogException if memory mapped files are not supported.
+         @sa useLogfile()
+         */
+        void useMappedLogfile (const std::string filePath,
+                               const size_t segmentSize = 16 * 1024 * 1024);
+        
+        /**
+         @brief Enables or disables the flight recorder.
+         @details Every message up to the level of the policy is written
+         with timestamp into a circular buffer of the logging thread, even if
+         the loglevel doesn't include it. Nothing is written to disk until
+         the buffers are dumped: when an error is logged, when
+         dumpFlightRecorder() is called or when the process crashes. A dump
+         writes the buffers of all threads (oldest line first) and empties
+         them. Dumps from the signal handler only use write(). The buffer
+         of an exited thread is reused by the next new thread, the lines of
+         the exited thread that weren't dumped yet are dropped. A changed
+         buffer size applies to the next message of each thread, the memory
+         of the buffers is kept while the Log exists.
+         @param policy The flight recorder policy.
+         @param dumpPath The file the dumps are appended to, stderr if
+         empty.
+         @throw LogException if the dump file can't be opened.
+         @sa dumpFlightRecorder() and LogFlightRecorderPolicy
+         */
+        void useFlightRecorder (const LogFlightRecorderPolicy &policy,
+                                const std::string &dumpPath = "");
+        
+        /**
+         @brief The current flight recorder policy.
+         @return The current flight recorder policy.
+         @sa useFlightRecorder()
+         */
+        LogFlightRecorderPolicy flightRecorderPolicy () const;
+        
+        /**
+         @brief Writes the buffers of the flight recorder of all threads.
+         @sa useFlightRecorder()
+         */
+        void dumpFlightRecorder ();
+        
+        /**
+         @brief Adds a destination for messages and errors (see LogSink.h).
+         @details As long as sinks are attached, they replace the console,
+         the logfile, the errorfile and the memory mapped logfile. Each
+         record is formatted once and then written to all sinks whose
+         loglevel includes it. Per-thread buffers are not used for sinks.
+         @param sink The sink, it is kept until it is removed.
+         @sa removeSink() and removeAllSinks()
+         */
+        void addSink (const std::shared_ptr<LogSink> &sink);
+        
+        /**
+         @brief Removes a sink added with addSink().
+         @details Buffered output of the sink is written before.
+         @param sink The sink to remove.
+         @sa addSink()
+         */
+        void removeSink (const std::shared_ptr<LogSink> &sink);
+        
+        /**
+         @brief Removes all sinks, the default outputs are used again.
+         @sa addSink()
+         */
+        void removeAllSinks ();
+        
+        /**
+         @brief Sets when buffered output is written to the logfiles.
+         @details Applies to the logfile and the errorfile. Anything buffered
+         with the old policy will be written immediately.
+         @param policy The new flush policy.
+         @sa flushPolicy(), flush() and LogFlushPolicy
+         */
+        void setFlushPolicy (const LogFlushPolicy &policy);
+        
+        /**
+         @brief The current flush policy.
+         @return The current flush policy.
+         @sa setFlushPolicy()
+         */
+        LogFlushPolicy flushPolicy () const;
+        
+        /**
+         @brief Sets when the logfile and the errorfile are rotated.
+         @details Rotation happens while logging, compression of rotated
+         files is done by a background thread.
+         @param policy The new rotation policy.
+         @sa rotationPolicy() and LogRotationPolicy
+         */
+        void setRotationPolicy (const LogRotationPolicy &policy);
+        
+        /**
+         @brief The current rotation policy.
+         @return The current rotation policy.
+         @sa setRotationPolicy()
+         */
+        LogRotationPolicy rotationPolicy () const;
+        
+        /**
+         @brief Limits how often each call site is written.
+         @details The state is kept in the LogSite of each call site without
+         locks, a dropped message isn't formatted at all. Messages logged
+         without a call site are limited by their text (f.e. print() or
+         error() with a string) or their format string (f.e. print() with
+         arguments).
+         @param limit The new rate limit.
+         @sa rateLimit() and LogRateLimit
+         */
+        void setRateLimit (const LogRateLimit &limit);
+        
+        /**
+         @brief The current rate limit.
+         @return The current rate limit.
+         @sa setRateLimit()
+         */
+        LogRateLimit rateLimit () const;
+        
+        /**
+         @brief Enables or disables per-thread buffers for normal output.
+         @details With per-thread buffers print() and printv() format the
+         message into a buffer owned by the calling thread. The buffer will be
+         handed to std::cout / the logfile in one piece when it is full or
+         when the oldest line in it reached the given age. The output lock is
+         only taken once per buffer instead of once per message. Lines of one
+         thread stay in order, lines of different threads are only ordered
+         per buffer. Errors are never buffered. Default: Disabled.
+         @param bufferSize Size of the buffer of each thread in bytes.
+         0 disables the per-thread buffers.
+         @param interval Maximum age of a buffered line in milliseconds.
+         0 only hands over full buffers (and on flush()).
+         @sa threadBufferSize() and flush()
+         */
+        void setThreadBufferSize (const size_t bufferSize,
+                                  const unsigned int interval = 100);
+        
+        /**
+         @brief The size of the per-thread buffers.
+         @return The size in bytes, 0 if per-thread buffers are disabled.
+         @sa setThreadBufferSize()
+         */
+        size_t threadBufferSize () const;
+        
+        /**
+         @brief Sets the precision of the time in front of each logfile line.
+         @details Default: LogTimestampPrecisionSeconds.
+         @param precision The new precision.
+         @sa timestampPrecision()
+         */
+        void setTimestampPrecision (const LogTimestampPrecision precision);
+        
+        /**
+         @brief The precision of the time in front of each logfile line.
+         @return The current precision.
+         @sa setTimestampPrecision()
+         */
+        LogTimestampPrecision timestampPrecision () const;
 
         /**
         @brief Enables or disables the use of ANSI SGR Codes.
         @details The Terminal have to support the ANSI SGR Codes. Default: Disabled.
+        Only used for std::cout, logfiles never get ANSI SGR Codes.
         @param useAnsiSgrCodes Setting this to true will enable the usage of ANSI SGR Codes.
+        @param onlyOnTerminal Only enable them if std::cout is a terminal (not
+        redirected into a file or a pipe). This parameter is optional.
         @sa useAnsiSgrCodes()
         */
-        void setUseAnsiSgrCodes (const bool useAnsiSgrCodes);
+        void setUseAnsiSgrCodes (const bool useAnsiSgrCodes,
+                                 const bool onlyOnTerminal = true);
 
         /**
         @brief Determines if ANSI SGR Codes are enabled.
@@ -286,17 +1015,145 @@ namespace rgp {
         */
         bool useAnsiSgrCodes () const;
         
+        /**
+         @brief Enables or disables the asynchronous mode.
+         @details In asynchronous mode print(), printv() and error() only put
+         the message into a bounded lock-free queue. A dedicated writer thread
+         takes the messages out of the queue in batches and writes them to
+         std::cout / std::cerr or the logfiles. The calling thread will never
+         wait for the output itself (only if the queue is completely full).
+         Disabling the asynchronous mode writes all queued messages before it
+         returns. Default: Disabled.
+         @param useAsyncMode Setting this to true will enable the asynchronous
+         mode.
+         @param queueCapacity The number of messages the queue can hold. Will
+         be rounded up to the next power of two. Only used when the queue is
+         created (first time the asynchronous mode gets enabled).
+         @throw LogException if the writer thread left running by a shutdown()
+         that timed out is still running.
+         @sa useAsyncMode() and flush()
+         */
+        void setUseAsyncMode (const bool useAsyncMode,
+                              const size_t queueCapacity = 8192);
+        
+        /**
+         @brief Determines if the asynchronous mode is enabled.
+         @return True if the asynchronous mode is enabled, false otherwise.
+         @sa setUseAsyncMode()
+         */
+        bool useAsyncMode () const;
+        
+        /**
+         @brief Sets what happens when the queue of the asynchronous mode is
+         full.
+         @details With a dropping policy a logging thread only waits for a
+         slow output if the oldest queued message must be kept, errors and
+         the format strings of the binary logfile are always kept. Dropped
+         messages are counted, see droppedMessages().
+         @param policy The overflow policy (LogOverflowPolicyBlock by
+         default).
+         @param level With LogOverflowPolicyDropBelowLevel messages more
+         detailed than this level are dropped.
+         @sa asyncOverflowPolicy() and setUseAsyncMode()
+         */
+        void setAsyncOverflowPolicy (const LogOverflowPolicy policy,
+                                     const Loglevel level = LoglevelWarning);
+        
+        /**
+         @brief The current overflow policy of the asynchronous mode.
+         @return The current overflow policy.
+         @sa setAsyncOverflowPolicy()
+         */
+        LogOverflowPolicy asyncOverflowPolicy () const;
+        
+        /**
+         @brief Number of messages dropped because the queue was full.
+         @return The number of dropped messages of all levels.
+         @sa setAsyncOverflowPolicy()
+         */
+        uint64_t droppedMessages () const;
+        
+        /**
+         @brief Number of messages of a level dropped because the queue was
+         full.
+         @param level The level of the messages.
+         @return The number of dropped messages of the level.
+         @sa setAsyncOverflowPolicy()
+         */
+        uint64_t droppedMessages (const Loglevel level) const;
+        
+        /**
+         @brief Enables or disables the collection of metrics about the Log.
+         @details Counts the written lines and bytes per level, measures how
+         long writing to the outputs and sinks takes and how long logging
+         threads wait for the output mutexes. Costs two clock reads per line
+         while enabled. Disabled by default.
+         @param collect True to collect the metrics.
+         @sa metrics() and setMetricsDump()
+         */
+        void setCollectMetrics (const bool collect);
+        
+        /**
+         @brief Determines if metrics are collected.
+         @return True if metrics are collected, false otherwise.
+         @sa setCollectMetrics()
+         */
+        bool collectMetrics () const;
+        
+        /**
+         @brief Takes a snapshot of the metrics.
+         @details The counters are read one by one without stopping the
+         logging threads, so they may be off by the lines written meanwhile.
+         @return The current metrics.
+         @sa setCollectMetrics() and LogMetrics
+         */
+        LogMetrics metrics () const;
+        
+        /**
+         @brief Sets all counters and histograms of the metrics to zero.
+         @sa metrics()
+         */
+        void resetMetrics ();
+        
+        /**
+         @brief Appends the metrics to a file periodically.
+         @details Every interval a snapshot is appended as one line of JSON
+         (see LogMetrics::toJson()) by the background flush thread. Enables the
+         collection of metrics.
+         @param path The file the metrics are appended to.
+         @param interval Time between two snapshots in milliseconds (0 stops
+         the dump).
+         @sa setCollectMetrics()
+         */
+        void setMetricsDump (const std::string &path,
+                             const unsigned int interval = 10000);
+        
+        /**
+         @brief Waits until all messages logged before are written.
+         @details Hands over the per-thread buffers of all threads. In
+         asynchronous mode this waits for the writer thread. Buffered output of
+         the logfiles will be written afterwards. Should be
+         called before the application exits, otherwise queued or buffered
+         messages may be lost.
+         @sa setUseAsyncMode() and setFlushPolicy()
+         */
+        void flush ();
+        
     private:
         
         // make constructor private (we are a singleton class)
-        Log () {}
+        Log ();
+        ~Log ();
         
         // disallow copy constructor
         Log (const Log &log) = delete;
         Log &operator = (Log const &) = delete;
         
-        // singleton instance
-        static Log *_sharedInstance;
+        // singleton instance (created once by sharedLog(), never destroyed)
+        static std::atomic<Log *> _sharedInstance;
+        
+        // shuts the instance down when the process exits
+        static void shutdownAtExit ();
         
         // protect cout with a mutex to make it thread-safe
         std::mutex _cout_mutex;
@@ -304,30 +1161,557 @@ namespace rgp {
         // protect cerr with a mutex to make it thread-safe
         std::mutex _cerr_mutex;
         
+        // serializes getline() and getc()
+        std::mutex _inputMutex;
+        
         // store the current loglevel
         std::atomic<Loglevel> _logLevel { LoglevelNormal };
         
         // if we are able to use the given logfile, this variable will be true
         std::atomic<bool> _hasLogfile { false };
         
-        // stores the path to the given logfile
-        std::string _logFilePath { "" };
+        // the opened logfile (protected by _cout_mutex)
+        std::unique_ptr<LogFile> _logFile;
         
         // if we are able to use the given error logfile,
         // this variable will be true
         std::atomic<bool> _hasErrorfile { false };
         
-        // stores the path to the given error logfile
-        std::string _errorFilePath { "" };
+        // the opened error logfile (protected by _cerr_mutex)
+        std::unique_ptr<LogFile> _errorFile;
+        
+        // the configuration read while logging, replaced as a whole
+        // (read-copy-update): logging threads load the pointer without
+        // locking, setters copy the snapshot, change the copy and publish it
+        std::atomic<const LogConfigSnapshot *> _config { nullptr };
+        
+        // incremented when a snapshot is replaced
+        std::atomic<uint64_t> _configEpoch { 1 };
+        
+        // serializes the setters and owns the current snapshot and the
+        // replaced ones that may still be read (freed when a later snapshot
+        // is published and no thread reads them anymore)
+        std::mutex _configMutex;
+        std::vector<std::unique_ptr<LogConfigSnapshot>> _configs;
+        
+        // the current snapshot (never null, not freed while the reference
+        // exists)
+        LogConfigRef config () const;
+        
+        // a copy of the current snapshot to change (_configMutex is locked)
+        LogConfigSnapshot &copyConfig ();
+        
+        // makes the last copy the current snapshot (_configMutex is locked)
+        void publishConfig ();
+        
+        // if a binary logfile is used, this variable will be true
+        std::atomic<bool> _hasBinaryLogfile { false };
+        
+        // the opened binary logfile (protected by _cout_mutex)
+        std::unique_ptr<LogFile> _binaryFile;
+        
+        // if a memory mapped logfile is used, this variable will be true
+        std::atomic<bool> _hasMappedLogfile { false };
+        
+        // the memory mapped logfile (thread-safe itself)
+        std::unique_ptr<LogMappedFile> _mappedFile;
+        
+        // if sinks are attached, this variable will be true
+        std::atomic<bool> _hasSinks { false };
+        
+        // the attached sinks, also serializes writing to them
+        mutable std::mutex _sinksMutex;
+        std::vector<std::shared_ptr<LogSink>> _sinks;
+        
+        // the line formatted for the sinks (protected by _sinksMutex)
+        std::string _sinkLine;
+        
+        // the format strings of all call sites, the index is the id - 1
+        std::mutex _formatsMutex;
+        std::vector<std::string> _formats;
+        
+        // compresses rotated logfiles
+        std::unique_ptr<LogCompressor> _compressor;
+        
+        // the policy used for both logfiles (protected by _flushMutex)
+        LogFlushPolicy _flushPolicy;
+        
+        // the rotation of both logfiles (protected by _flushMutex)
+        LogRotationPolicy _rotationPolicy;
+        
+        // size of the per-thread buffers (0 = disabled)
+        std::atomic<size_t> _threadBufferSize { 0 };
+        
+        // maximum age of a line in a per-thread buffer (protected by
+        // _flushMutex)
+        unsigned int _threadBufferInterval { 0 };
+        
+        // the buffers of all threads that used them
+        std::mutex _threadBuffersMutex;
+        std::vector<LogThreadBuffer *> _threadBuffers;
+        
+        // line formatted by writeOutput() (protected by _cout_mutex)
+        std::string _outputLine;
+        
+        // line formatted by writeError() (protected by _cerr_mutex)
+        std::string _errorLine;
+        
+        // writes buffered output of the logfiles if the flush interval is set
+        // and hands over old per-thread buffers
+        std::thread _flushThread;
+        mutable std::mutex _flushMutex;
+        std::condition_variable _flushCondition;
+        bool _flushStop { false };
 
-        // determines if ANSI SGR Codes should be used or not
-        bool _useAnsiSgrCodes { false };
-        
-        // creates ANSI SGR Code for given foreground and background colors
-        std::string createSelectGraphicRenditionCode(const AnsiSgrFgColor fgcolor,
-                                                     const AnsiSgrBgColor bgcolor);
-        // creates ANSI SGR Reset Code
-        std::string resetSelectGraphicRenditionCode();
+        // determines if messages go through the async queue
+        std::atomic<bool> _useAsyncMode { false };
+        
+        // queue between logging threads and the writer thread (created on
+        // first use and never destroyed while the log exists, atomic so the
+        // metrics can read it without the control mutex)
+        std::atomic<LogRingBuffer<LogRecord> *> _asyncQueue { nullptr };
+        
+        // the writer thread of the async mode
+        std::thread _asyncThread;
+        
+        // tells the writer thread to drain the queue and quit
+        std::atomic<bool> _asyncStop { false };
+        
+        // true while the writer thread waits on _asyncCondition
+        std::atomic<bool> _asyncSleeping { false };
+        
+        // wakes up the writer thread and threads waiting in flush()
+        std::mutex _asyncMutex;
+        std::condition_variable _asyncCondition;
+        std::condition_variable _asyncFlushCondition;
+        
+        // serializes configuration changes that start or stop threads
+        mutable std::mutex _controlMutex;
+        
+        // flush tickets requested by flush() / completed by the writer thread
+        uint64_t _asyncFlushRequested { 0 };
+        uint64_t _asyncFlushCompleted { 0 };
+        
+        // set by the writer thread when it quits (protected by _asyncMutex,
+        // signaled with _asyncFlushCondition)
+        bool _asyncStopped { false };
+        
+        // messages dropped because the async queue was full, per level
+        std::atomic<uint64_t> _droppedMessages[LoglevelTrace + 1];
+        
+        // true if metrics are collected
+        std::atomic<bool> _collectMetrics { false };
+        
+        // written lines and bytes per level
+        std::atomic<uint64_t> _lineCounts[LoglevelTrace + 1];
+        std::atomic<uint64_t> _byteCounts[LoglevelTrace + 1];
+        
+        // contention of _cout_mutex and _cerr_mutex
+        std::atomic<uint64_t> _outputContended { 0 };
+        std::atomic<uint64_t> _outputWait { 0 };
+        std::atomic<uint64_t> _errorContended { 0 };
+        std::atomic<uint64_t> _errorWait { 0 };
+        
+        // durations of writing to the outputs and to each sink (the sink
+        // histograms are parallel to _sinks and protected by _sinksMutex)
+        std::unique_ptr<LogHistogram> _outputLatency;
+        std::unique_ptr<LogHistogram> _errorLatency;
+        std::vector<std::unique_ptr<LogHistogram>> _sinkLatencies;
+        
+        // file the metrics are appended to and the interval in milliseconds
+        // (protected by _flushMutex)
+        std::string _metricsPath;
+        unsigned int _metricsInterval { 0 };
+        
+        // interval in milliseconds the summaries of dropped messages are
+        // written in if the rate limit is enabled (protected by _flushMutex)
+        unsigned int _summaryInterval { 0 };
+        
+        // call sites of messages logged as text, selected by the hash of the
+        // text
+        std::unique_ptr<LogSite[]> _textSites;
+        
+        // call sites with summaries of dropped messages to write
+        std::mutex _pendingSitesMutex;
+        std::vector<LogSite *> _pendingSites;
+        
+        // counts a line that is written
+        void countLine (const LogRecord &record);
+        
+        // locks a mutex and measures the time waited if it was locked
+        void lockMeasured (std::unique_lock<std::mutex> &lock,
+                           std::atomic<uint64_t> &contended,
+                           std::atomic<uint64_t> &wait);
+        
+        // appends a snapshot of the metrics to the dump file
+        void dumpMetrics (const std::string &path);
+        
+        // writes the prompt of getline() / getc() and holds the console
+        void showPrompt (const std::string &text);
+        
+        // applies the rate limit and logs a format string with arguments
+        // (output tells if it is written or only recorded by the flight
+        // recorder)
+        void logFormat (const Loglevel level, const bool output,
+                        const char *format, const LogArgument *arguments,
+                        const size_t count);
+        
+        // formats and logs a format string with arguments without the rate
+        // limit (f.e. the summaries of the rate limit)
+        void writeFormat (const Loglevel level, const bool output,
+                          const char *format, const LogArgument *arguments,
+                          const size_t count);
+        
+        // logs the format string and arguments of a call site
+        void logSite (LogSite &site, const Loglevel level, const bool output,
+                      const char *format, const LogArgument *arguments,
+                      const size_t count);
+        
+        // applies the rate limit of a call site, writes the summaries of
+        // dropped messages and returns false if the message is dropped
+        bool admitSite (LogSite &site, const Loglevel level,
+                        const LogArgument *arguments, const size_t count);
+        
+        // applies the rate limit to a message logged as text (seed is mixed
+        // into the hash of the text, f.e. an error number)
+        bool admitText (const Loglevel level, const LogStringRef text,
+                        const uint64_t seed = 0);
+        
+        // applies the rate limit to a format string logged without a call
+        // site, the format string stands for the call site (seed is mixed
+        // into it, f.e. a category)
+        bool admitFormat (const Loglevel level, const char *format,
+                          const LogArgument *arguments, const size_t count,
+                          const uint64_t seed = 0);
+        
+        // applies the rate limit with the hash of the message
+        bool admitHash (LogSite &site, const Loglevel level, const uint64_t hash,
+                        const LogConfigSnapshot &config);
+        
+        // counts a dropped message and remembers the call site for its
+        // summary (counter is repeated or suppressed of the site)
+        void countSiteDrop (LogSite &site, const Loglevel level,
+                            std::atomic<uint32_t> &counter);
+        
+        // writes the summaries of the dropped messages of a call site
+        void writeSiteSummaries (LogSite &site, const Loglevel level);
+        
+        // writes the summaries of all call sites that dropped messages
+        void writePendingSummaries ();
+        
+        // gives the format string of a call site an id
+        uint32_t registerFormat (LogSite &site, const char *format);
+        
+        // hands a record to the thread buffer, the writer thread or writes it
+        // directly
+        void submit (LogRecord &record);
+        
+        // hands a record to the writer thread or writes it directly
+        void dispatch (LogRecord &record);
+        
+        // puts a record into the async queue (applies the overflow policy
+        // if the queue is full)
+        void enqueue (LogRecord &record);
+        
+        // puts a record into the full async queue according to the overflow
+        // policy, returns false if it was dropped
+        bool enqueueOverflow (LogRecord &record);
+        
+        // counts a record that was dropped
+        void countDropped (const LogRecord &record);
+        
+        // writes the timestamp in front of a line into the buffer (at least
+        // LogTimestamp::kMaxLength bytes), returns the length
+        size_t formatPrefix (const LogRecord &record, char *prefix) const;
+        
+        // formats a record once and writes it to all sinks that accept it
+        // (_sinksMutex is locked)
+        void writeSinks (const LogRecord &record);
+        
+        // writes a record into the memory mapped logfile without locking,
+        // returns false if it isn't available
+        bool writeMapped (const LogRecord &record);
+        
+        // appends the formatted output line of a record to the string
+        void formatOutput (const LogRecord &record, std::string &line);
+        
+        // writes formatted lines to std::cout or the logfile
+        // (_cout_mutex is locked)
+        void writeFormattedOutput (const std::string &lines);
+        
+        // writes a record to std::cout or the logfile (_cout_mutex is locked)
+        void writeOutput (const LogRecord &record);
+        
+        // formats a record into the buffer of the calling thread
+        void bufferOutput (const LogRecord &record, const size_t bufferSize);
+        
+        // hands the content of a per-thread buffer to the output
+        void handOver (LogThreadBuffer &buffer);
+        
+        // hands over all per-thread buffers (only old ones if onlyDue is set)
+        void handOverThreadBuffers (const bool onlyDue);
+        
+        // hands over and forgets the buffer of an exiting thread
+        void releaseThreadBuffer (LogThreadBuffer *buffer);
+        
+        friend struct LogThreadBufferHolder;
+        friend class LogCategory;
+        
+        // all categories, never removed (protected by _categoriesMutex)
+        mutable std::mutex _categoriesMutex;
+        std::vector<std::unique_ptr<LogCategory>> _categories;
+        
+        // the sampling of the Log (protected by _categoriesMutex)
+        LogSamplingPolicy _samplingPolicy;
+        
+        // decides which messages are kept by the sampling of the Log
+        std::unique_ptr<LogSampler> _sampler;
+        
+        // true if the Log or any category drops messages by sampling
+        std::atomic<bool> _isSampling { false };
+        
+        // true if a message of the level is kept by the sampler (only debug
+        // and trace messages are sampled)
+        bool isSampled (const Loglevel level, LogSampler &sampler) {
+            return level < LoglevelDebug ||
+                   !_isSampling.load(std::memory_order_relaxed) ||
+                   keepSample(sampler);
+        };
+        
+        // asks the sampler
+        static bool keepSample (LogSampler &sampler);
+        
+        // keeps the most recent lines of every thread in memory
+        std::unique_ptr<LogFlightRecorder> _flightRecorder;
+        
+        // the policy of the flight recorder (protected by _controlMutex)
+        LogFlightRecorderPolicy _flightRecorderPolicy;
+        
+        // the most detailed level that is recorded (LoglevelOff = disabled)
+        std::atomic<Loglevel> _recordLevel { LoglevelOff };
+        
+        // dump the flight recorder when an error is logged
+        std::atomic<bool> _dumpOnError { false };
+        
+        // true if messages of the level go to the flight recorder
+        bool isRecorded (const Loglevel level) const {
+            return level != LoglevelOff &&
+                   _recordLevel.load(std::memory_order_relaxed) >= level;
+        };
+        
+        // writes a record into the flight recorder of the calling thread and
+        // dumps it on errors if requested
+        void recordFlight (const LogRecord &record, const char *text,
+                           const size_t size);
+        
+        // recalculates _isSampling (_categoriesMutex is locked)
+        void updateSampling ();
+        
+        // sets the sampling of a category (or lets it follow the Log)
+        void setCategorySamplingPolicy (LogCategory &category,
+                                        const LogSamplingPolicy &policy,
+                                        const bool followLog);
+        
+        // the sampling of a category
+        LogSamplingPolicy categorySamplingPolicy (const LogCategory &category) const;
+        
+        // sets the level of a category (an invalid level follows the Log)
+        void setCategoryLoglevel (LogCategory &category, const Loglevel level,
+                                  const bool followLog);
+        
+        // logs a text for a category (the level is already checked)
+        void logCategory (const LogCategory &category, const Loglevel level,
+                          const bool output, const LogStringRef text,
+                          const AnsiSgrFgColor fgcolor,
+                          const AnsiSgrBgColor bgcolor);
+        
+        // logs a format string for a category (the level is already checked)
+        void logCategoryFormat (const LogCategory &category, const Loglevel level,
+                                const bool output, const char *format,
+                                const LogArgument *arguments, const size_t count);
+        
+        // writes a record to std::cerr or the errorfile (_cerr_mutex is locked)
+        void writeError (const LogRecord &record);
+        
+        // main loop of the writer thread
+        void asyncWriterLoop ();
+        
+        // lets the writer thread drain the queue and waits for it at most
+        // timeout milliseconds (0 = forever), returns false if it didn't quit
+        // in time (_controlMutex is locked)
+        bool stopAsyncWriter (const unsigned int timeout);
+        
+        // writes a batch of records taken out of the async queue
+        void writeBatch (LogRecord *records, const size_t count);
+        
+        // main loop of the flush thread
+        void flushLoop ();
+        
+        // stops the flush thread (_flushMutex has to be locked)
+        void stopFlushThread (std::unique_lock<std::mutex> &lock);
+        
+        // (re)starts the flush thread if it is needed (_flushMutex has to be
+        // locked)
+        void restartFlushThread (std::unique_lock<std::mutex> &lock);
+        
+        // writes buffered output of both logfiles
+        void flushFiles ();
+
+    };
+    
+    /**
+     @brief A named category of messages with its own loglevel.
+     @details Obtained with Log::category(). Checking whether a level is
+     enabled is a single relaxed atomic load, so disabled messages of a
+     category cost almost nothing. Messages are written with the name of the
+     category in front ("[net] connected"). The loglevel of the Log itself
+     doesn't filter messages of a category.
+     */
+    class RGPUTILS_EXPORT LogCategory {
+        
+    public:
+        ~LogCategory ();
+        
+        LogCategory (const LogCategory &) = delete;
+        LogCategory &operator = (const LogCategory &) = delete;
+        
+        /** The name of the category. */
+        const std::string &name () const {
+            return _name;
+        };
+        
+        /** The current loglevel of the category. */
+        Loglevel loglevel () const {
+            return _level.load(std::memory_order_relaxed);
+        };
+        
+        /**
+         @brief Sets the loglevel of the category.
+         @details The category won't follow the loglevel of the Log anymore.
+         @sa followLoglevel()
+         */
+        void setLoglevel (const Loglevel level) {
+            _log->setCategoryLoglevel(*this, level, false);
+        };
+        
+        /** The category follows the loglevel of the Log again. */
+        void followLoglevel () {
+            _log->setCategoryLoglevel(*this, LoglevelOff, true);
+        };
+        
+        /** True if messages of the level are logged for this category. */
+        bool isEnabled (const Loglevel level) const {
+            return level != LoglevelOff &&
+                   _level.load(std::memory_order_relaxed) >= level;
+        };
+        
+        /** The current sampling policy of the category. */
+        LogSamplingPolicy samplingPolicy () const {
+            return _log->categorySamplingPolicy(*this);
+        };
+        
+        /**
+         @brief Sets which debug and trace messages of the category are kept.
+         @details The category won't follow the sampling policy of the Log
+         anymore.
+         @sa followSamplingPolicy() and Log::setSamplingPolicy()
+         */
+        void setSamplingPolicy (const LogSamplingPolicy &policy) {
+            _log->setCategorySamplingPolicy(*this, policy, false);
+        };
+        
+        /** The category follows the sampling policy of the Log again. */
+        void followSamplingPolicy () {
+            _log->setCategorySamplingPolicy(*this, LogSamplingPolicy(), true);
+        };
+        
+        /** Logs the text with the given level (see Log::log()). */
+        void log (const Loglevel level, const LogStringRef text,
+                  const AnsiSgrFgColor fgcolor = AnsiSgrFgColorDefault,
+                  const AnsiSgrBgColor bgcolor = AnsiSgrBgColorDefault) {
+            bool output = isEnabled(level) && _log->isSampled(level, *_sampler);
+            if (output || _log->isRecorded(level)) {
+                _log->logCategory(*this, level, output, text, fgcolor, bgcolor);
+            }
+        };
+        
+        /** Logs a format string with arguments (see LogFormat.h). */
+        template <typename Arg, typename... Args>
+        typename std::enable_if<!std::is_same<Arg, AnsiSgrFgColor>::value>::type
+        log (const Loglevel level, const char *format, const Arg &arg,
+             const Args &... args)
+        {
+            bool output = isEnabled(level) && _log->isSampled(level, *_sampler);
+            if (output || _log->isRecorded(level)) {
+                const LogArgument arguments[] = { arg, args... };
+                _log->logCategoryFormat(*this, level, output, format, arguments,
+                                        1 + sizeof...(Args));
+            }
+        };
+        
+        /** Same as log() with LoglevelNormal. */
+        void print (const LogStringRef text,
+                    const AnsiSgrFgColor fgcolor = AnsiSgrFgColorDefault,
+                    const AnsiSgrBgColor bgcolor = AnsiSgrBgColorDefault) {
+            log(LoglevelNormal, text, fgcolor, bgcolor);
+        };
+        
+        /** Same as log() with LoglevelVerbose. */
+        void printv (const LogStringRef text,
+                     const AnsiSgrFgColor fgcolor = AnsiSgrFgColorDefault,
+                     const AnsiSgrBgColor bgcolor = AnsiSgrBgColorDefault) {
+            log(LoglevelVerbose, text, fgcolor, bgcolor);
+        };
+        
+        /** Same as log() with LoglevelError. */
+        void error (const LogStringRef text) {
+            log(LoglevelError, text);
+        };
+        
+        /** Format string version of print(). */
+        template <typename Arg, typename... Args>
+        typename std::enable_if<!std::is_same<Arg, AnsiSgrFgColor>::value>::type
+        print (const char *format, const Arg &arg, const Args &... args)
+        {
+            log(LoglevelNormal, format, arg, args...);
+        };
+        
+        /** Format string version of printv(). */
+        template <typename Arg, typename... Args>
+        typename std::enable_if<!std::is_same<Arg, AnsiSgrFgColor>::value>::type
+        printv (const char *format, const Arg &arg, const Args &... args)
+        {
+            log(LoglevelVerbose, format, arg, args...);
+        };
+        
+        /** Format string version of error(). */
+        template <typename Arg, typename... Args>
+        void error (const char *format, const Arg &arg, const Args &... args)
+        {
+            log(LoglevelError, format, arg, args...);
+        };
+        
+    private:
+        friend class Log;
+        
+        LogCategory (Log *log, const std::string &name, const Loglevel level);
+        
+        // the level is checked by every logging thread, keep it on its own
+        // cache line, away from other data that is written
+        alignas(64) std::atomic<Loglevel> _level;
+        
+        alignas(64) Log *_log;
+        std::string _name;
+        
+        // the level was set for the category (protected by the categories
+        // mutex of the Log)
+        bool _hasOwnLevel { false };
+        
+        // the sampling of the category and if it was set for the category
+        // (protected by the categories mutex of the Log)
+        std::unique_ptr<LogSampler> _sampler;
+        LogSamplingPolicy _samplingPolicy;
+        bool _hasOwnSampling { false };
     };
     
     /** Exception class for Log */
@@ -0,0 +1,320 @@
+/*
+ RGPUtils
+ LogFormat.h
+
+ Typed arguments and call site descriptions for format strings used by the
+ Log class. A format string contains "{}" as placeholder for each argument,
+ "{{" and "}}" will be written as "{" and "}".
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogFormat_H__
+#define __RGPUtils__LogFormat_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// on windows we need the exports for creating the dll
+#if defined(_WIN32)
+  #if defined(RGPUTILS_EXPORTS)
+    #define RGPUTILS_EXPORT __declspec(dllexport)
+  #else
+    #define RGPUTILS_EXPORT __declspec(dllimport)
+  #endif /* defined (RGPUTILS_EXPORTS) */
+#else /* defined (_WIN32) */
+ #define RGPUTILS_EXPORT
+#endif
+
+namespace rgp {
+
+    /**
+     @brief A reference to characters that are not owned.
+     @details Used by the Log class to accept string literals, C strings and
+     std::string without copying them into a temporary std::string.
+     */
+    class LogStringRef {
+
+    public:
+        LogStringRef (const char *data)
+        : _data(data != nullptr ? data : "(null)"), _size(strlen(_data))
+        {};
+        LogStringRef (const char *data, const size_t size)
+        : _data(data), _size(size)
+        {};
+        LogStringRef (const std::string &string)
+        : _data(string.data()), _size(string.size())
+        {};
+
+        ///< The characters (not null terminated)
+        const char *data () const {
+            return _data;
+        };
+
+        ///< Number of characters
+        size_t size () const {
+            return _size;
+        };
+
+        ///< A copy of the characters
+        std::string str () const {
+            return std::string { _data, _size };
+        };
+
+    private:
+        const char *_data;
+        size_t _size;
+    };
+
+    /** Describes the type of a LogArgument. */
+    typedef enum : uint8_t {
+        LogArgumentTypeNone = 0,
+        LogArgumentTypeInt,
+        LogArgumentTypeUInt,
+        LogArgumentTypeDouble,
+        LogArgumentTypeBool,
+        LogArgumentTypeChar,
+        LogArgumentTypeString,
+        LogArgumentTypePointer
+    } LogArgumentType;
+
+    /**
+     @brief A single argument for a format string.
+     @details Arguments are created implicitly from the values given to the
+     formatting methods of the Log class. Strings are only referenced, so an
+     argument must not outlive the value it was created from.
+     */
+    class RGPUTILS_EXPORT LogArgument {
+
+    public:
+        LogArgument () : _type(LogArgumentTypeNone) { _value.u = 0; };
+
+        LogArgument (const bool value) : _type(LogArgumentTypeBool) {
+            _value.u = value ? 1 : 0;
+        };
+        LogArgument (const char value) : _type(LogArgumentTypeChar) {
+            _value.u = (unsigned char)value;
+        };
+        LogArgument (const signed char value) : _type(LogArgumentTypeInt) {
+            _value.i = value;
+        };
+        LogArgument (const unsigned char value) : _type(LogArgumentTypeUInt) {
+            _value.u = value;
+        };
+        LogArgument (const short value) : _type(LogArgumentTypeInt) {
+            _value.i = value;
+        };
+        LogArgument (const unsigned short value) : _type(LogArgumentTypeUInt) {
+            _value.u = value;
+        };
+        LogArgument (const int value) : _type(LogArgumentTypeInt) {
+            _value.i = value;
+        };
+        LogArgument (const unsigned int value) : _type(LogArgumentTypeUInt) {
+            _value.u = value;
+        };
+        LogArgument (const long value) : _type(LogArgumentTypeInt) {
+            _value.i = value;
+        };
+        LogArgument (const unsigned long value) : _type(LogArgumentTypeUInt) {
+            _value.u = value;
+        };
+        LogArgument (const long long value) : _type(LogArgumentTypeInt) {
+            _value.i = value;
+        };
+        LogArgument (const unsigned long long value)
+        : _type(LogArgumentTypeUInt) {
+            _value.u = value;
+        };
+        LogArgument (const float value) : _type(LogArgumentTypeDouble) {
+            _value.d = value;
+        };
+        LogArgument (const double value) : _type(LogArgumentTypeDouble) {
+            _value.d = value;
+        };
+        LogArgument (const long double value) : _type(LogArgumentTypeDouble) {
+            _value.d = (double)value;
+        };
+        LogArgument (const char *value) : _type(LogArgumentTypeString) {
+            _value.s.data = value != nullptr ? value : "(null)";
+            _value.s.size = strlen(_value.s.data);
+        };
+        LogArgument (const char *value, const size_t size)
+        : _type(LogArgumentTypeString) {
+            _value.s.data = value;
+            _value.s.size = size;
+        };
+        LogArgument (const std::string &value) : _type(LogArgumentTypeString) {
+            _value.s.data = value.data();
+            _value.s.size = value.size();
+        };
+        LogArgument (const void *value) : _type(LogArgumentTypePointer) {
+            _value.u = (uint64_t)(uintptr_t)value;
+        };
+
+        ///< The type of the argument
+        LogArgumentType type () const {
+            return _type;
+        };
+
+        ///< Value of LogArgumentTypeInt
+        int64_t intValue () const {
+            return _value.i;
+        };
+
+        ///< Value of LogArgumentTypeUInt, LogArgumentTypeBool,
+        ///< LogArgumentTypeChar and LogArgumentTypePointer
+        uint64_t uintValue () const {
+            return _value.u;
+        };
+
+        ///< Value of LogArgumentTypeDouble
+        double doubleValue () const {
+            return _value.d;
+        };
+
+        ///< Characters of LogArgumentTypeString (not null terminated)
+        const char *stringData () const {
+            return _value.s.data;
+        };
+
+        ///< Length of LogArgumentTypeString
+        size_t stringSize () const {
+            return _value.s.size;
+        };
+
+    private:
+        LogArgumentType _type;
+
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+            struct {
+                const char *data;
+                size_t size;
+            } s;
+        } _value;
+    };
+
+    /**
+     @brief Describes a single logging call site.
+     @details Used by the RGPLOG*_FMT macros as a static variable. The format
+     string of the call site gets an id on first use, which is written into
+     binary logfiles instead of the format string itself. The remaining
+     members hold the state of the rate limit of the call site (see
+     Log::setRateLimit()), they are only accessed with atomic operations.
+     */
+    struct LogSite {
+
+        /** Id of the format string (0 until first use). */
+        std::atomic<uint32_t> formatId;
+
+        /** Theoretical arrival time of the next message in nanoseconds
+         (state of the token bucket). */
+        std::atomic<int64_t> rateTime;
+
+        /** Hash of the arguments of the last written message. */
+        std::atomic<uint64_t> lastHash;
+
+        /** Time of the last written message in nanoseconds. */
+        std::atomic<int64_t> lastTime;
+
+        /** Messages dropped because they repeated the last one. */
+        std::atomic<uint32_t> repeated;
+
+        /** Messages dropped because the token bucket was empty. */
+        std::atomic<uint32_t> suppressed;
+
+        /** Level of the last dropped message. */
+        std::atomic<uint8_t> droppedLevel;
+
+        /** True while the Log remembers the call site for writing the
+         summaries of dropped messages. */
+        std::atomic<bool> pending;
+    };
+
+    /**
+     @brief A named value for structured logging.
+     @details Like LogArgument only references strings, so a field must not
+     outlive the values it was created from.
+     */
+    struct LogField {
+
+        LogField (const char *key, const LogArgument &value)
+        : key(key), value(value)
+        {};
+
+        /** Name of the field (written without escaping in logfmt). */
+        const char *key;
+
+        /** Value of the field. */
+        LogArgument value;
+    };
+
+    /** Describes the encoding of structured log records. */
+    typedef enum : uint8_t {
+        /** key=value pairs separated by spaces, values are quoted if needed */
+        LogStructuredFormatLogfmt = 0,
+        /** a single JSON object per line */
+        LogStructuredFormatJson
+    } LogStructuredFormat;
+
+    /**
+     @brief Encodes a structured record.
+     @details Writes the fields "ts", "level" and "msg" followed by the given
+     fields. Strings are escaped, nothing but the output is allocated.
+     @param output The encoded record will be appended to this string.
+     @param format The encoding.
+     @param time The formatted time (not escaped).
+     @param level The name of the level (not escaped).
+     @param message The message.
+     @param messageSize Length of the message.
+     @param fields The fields.
+     @param count Number of fields.
+     */
+    RGPUTILS_EXPORT void encodeLogFields (std::string &output,
+                                          const LogStructuredFormat format,
+                                          const char *time, const size_t timeSize,
+                                          const char *level,
+                                          const char *message,
+                                          const size_t messageSize,
+                                          const LogField *fields,
+                                          const size_t count);
+
+    /**
+     @brief Formats a format string with the given arguments.
+     @details Every "{}" in the format string will be replaced by the next
+     argument. Placeholders without an argument stay as they are,
+     arguments without a placeholder are ignored.
+     @param output The formatted text will be appended to this string.
+     @param format The format string.
+     @param arguments The arguments.
+     @param count Number of arguments.
+     */
+    RGPUTILS_EXPORT void formatLogMessage (std::string &output,
+                                           const char *format,
+                                           const LogArgument *arguments,
+                                           const size_t count);
+}
+
+#endif // defined(__RGPUtils__LogFormat_H__) header guard
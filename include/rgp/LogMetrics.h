@@ -0,0 +1,166 @@
+/*
+ RGPUtils
+ LogMetrics.h
+
+ Metrics about the Log class itself: what was written, how long writing
+ took and how often logging threads had to wait. Collected when enabled
+ with Log::setCollectMetrics(), read with Log::metrics().
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogMetrics_H__
+#define __RGPUtils__LogMetrics_H__
+
+#include <rgp/Log.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// on windows we need the exports for creating the dll
+#if defined(_WIN32)
+  #if defined(RGPUTILS_EXPORTS)
+    #define RGPUTILS_EXPORT __declspec(dllexport)
+  #else
+    #define RGPUTILS_EXPORT __declspec(dllimport)
+  #endif /* defined (RGPUTILS_EXPORTS) */
+#else /* defined (_WIN32) */
+ #define RGPUTILS_EXPORT
+#endif
+
+namespace rgp {
+
+    class LogSink;
+
+    /**
+     @brief A histogram of durations with power of two buckets.
+     */
+    struct RGPUTILS_EXPORT LogLatencyHistogram {
+
+        /** Number of buckets. */
+        static const size_t kBucketCount = 40;
+
+        LogLatencyHistogram ();
+
+        /** Bucket i counts durations of at least 2^(i-1) and less than 2^i
+         nanoseconds (bucket 0 counts durations of 0), the last bucket also
+         counts all longer durations. */
+        uint64_t buckets[kBucketCount];
+
+        /** Number of measured durations. */
+        uint64_t count;
+
+        /** Sum of all durations in nanoseconds. */
+        uint64_t totalNanoseconds;
+
+        /** Longest duration in nanoseconds. */
+        uint64_t maxNanoseconds;
+
+        /**
+         @brief An upper bound of a percentile.
+         @param p The percentile (0.0 - 1.0, f.e. 0.99).
+         @return The upper end of the bucket holding the percentile in
+         nanoseconds (0 if nothing was measured).
+         */
+        uint64_t percentile (const double p) const;
+    };
+
+    /** Contention of a mutex of the Log. */
+    struct RGPUTILS_EXPORT LogMutexMetrics {
+
+        LogMutexMetrics () : contended(0), waitNanoseconds(0) {};
+
+        /** Number of times a logging thread found the mutex locked. */
+        uint64_t contended;
+
+        /** Time logging threads waited for the mutex in nanoseconds. */
+        uint64_t waitNanoseconds;
+    };
+
+    /** Metrics of a sink attached with Log::addSink(). */
+    struct RGPUTILS_EXPORT LogSinkMetrics {
+
+        /** The sink. */
+        std::shared_ptr<LogSink> sink;
+
+        /** Durations of LogSink::write(). */
+        LogLatencyHistogram writeLatency;
+    };
+
+    /**
+     @brief A snapshot of the metrics of the Log.
+     @details All counters start when the collection is enabled or the
+     metrics are reset. The counters are arrays indexed by Loglevel
+     (LoglevelError for errors).
+     */
+    struct RGPUTILS_EXPORT LogMetrics {
+
+        LogMetrics ();
+
+        /** Time of the snapshot in nanoseconds since the epoch. */
+        int64_t timestamp;
+
+        /** Logged lines per level (dropped messages included). */
+        uint64_t lines[LoglevelTrace + 1];
+
+        /** Logged bytes of the messages (without timestamp) per level. */
+        uint64_t bytes[LoglevelTrace + 1];
+
+        /** Messages dropped because the async queue was full, per level
+         (counted even if the collection is disabled). */
+        uint64_t dropped[LoglevelTrace + 1];
+
+        /** Number of times a buffer was written to a logfile. */
+        uint64_t flushes;
+
+        /** Contention of the output mutex (std::cout / logfile). */
+        LogMutexMetrics outputMutex;
+
+        /** Contention of the error mutex (std::cerr / errorfile). */
+        LogMutexMetrics errorMutex;
+
+        /** Records in the async queue (0 if the async mode isn't used). */
+        size_t queueDepth;
+
+        /** Capacity of the async queue (0 if it wasn't created). */
+        size_t queueCapacity;
+
+        /** Durations of writing a record to std::cout / the logfile. */
+        LogLatencyHistogram outputLatency;
+
+        /** Durations of writing a record to std::cerr / the errorfile. */
+        LogLatencyHistogram errorLatency;
+
+        /** Metrics of all sinks. */
+        std::vector<LogSinkMetrics> sinks;
+
+        /**
+         @brief Encodes the metrics as a single line JSON object.
+         @details Histograms are written as count, mean, p50, p99, p999 and
+         max in nanoseconds.
+         @return The JSON object (without newline).
+         */
+        std::string toJson () const;
+    };
+}
+
+#endif // defined(__RGPUtils__LogMetrics_H__) header guard
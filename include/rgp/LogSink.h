@@ -0,0 +1,287 @@
+/*
+ RGPUtils
+ LogSink.h
+
+ Destinations for the output of the Log class. A record is formatted only
+ once and then handed to every sink attached with Log::addSink() whose
+ loglevel includes the level of the record.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogSink_H__
+#define __RGPUtils__LogSink_H__
+
+#include <rgp/Log.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// on windows we need the exports for creating the dll
+#if defined(_WIN32)
+  #if defined(RGPUTILS_EXPORTS)
+    #define RGPUTILS_EXPORT __declspec(dllexport)
+  #else
+    #define RGPUTILS_EXPORT __declspec(dllimport)
+  #endif /* defined (RGPUTILS_EXPORTS) */
+#else /* defined (_WIN32) */
+ #define RGPUTILS_EXPORT
+#endif
+
+namespace rgp {
+
+    /**
+     @brief A formatted record handed to the sinks.
+     @details The pointers are only valid during LogSink::write().
+     */
+    struct LogSinkRecord {
+
+        /** The level of the record (LoglevelError for errors). */
+        Loglevel level;
+
+        /** Time of the record in nanoseconds since the epoch. */
+        int64_t timestamp;
+
+        /** Colors of the record (only used for console output). */
+        AnsiSgrFgColor fgcolor;
+        AnsiSgrBgColor bgcolor;
+
+        /** The complete line: timestamp, message and newline. */
+        const char *line;
+        size_t lineSize;
+
+        /** Only the message (part of line, no newline). */
+        const char *message;
+        size_t messageSize;
+    };
+
+    /**
+     @brief Base class of all sinks.
+     @details The Log class never calls write(), flush() or flushIfDue() of
+     its sinks at the same time, so sinks don't need to synchronize them.
+     */
+    class RGPUTILS_EXPORT LogSink {
+
+    public:
+        LogSink (const Loglevel level = LoglevelTrace) : _level(level) {};
+        virtual ~LogSink () {};
+
+        LogSink (const LogSink &) = delete;
+        LogSink &operator = (const LogSink &) = delete;
+
+        /**
+         @brief The most detailed level written by this sink.
+         @details Records are filtered by the loglevel of the Log first.
+         */
+        Loglevel loglevel () const {
+            return _level.load(std::memory_order_relaxed);
+        };
+
+        /** Sets the most detailed level written by this sink. */
+        void setLoglevel (const Loglevel level) {
+            _level.store(level, std::memory_order_relaxed);
+        };
+
+        /** True if records of the level are written by this sink. */
+        bool accepts (const Loglevel level) const {
+            return level != LoglevelOff && level <= loglevel();
+        };
+
+        /** Writes a record. */
+        virtual void write (const LogSinkRecord &record) = 0;
+
+        /** Writes everything that is buffered. */
+        virtual void flush () {};
+
+        /** Called regularly by the flush thread of the Log. */
+        virtual void flushIfDue () {};
+
+        /**
+         @brief Called by the writer thread of the asynchronous mode before
+         it writes a batch of records.
+         @details Sinks may collect the records until endBatch() and write
+         them together.
+         */
+        virtual void beginBatch () {};
+
+        /** Called after the records of a batch were written. */
+        virtual void endBatch () {};
+
+    private:
+        std::atomic<Loglevel> _level;
+    };
+
+    /**
+     @brief Writes messages to std::cout and errors to std::cerr.
+     @details Lines don't get a timestamp, colors are written as ANSI SGR
+     codes if enabled and the stream is a terminal. Each line is written
+     with a single write.
+     */
+    class RGPUTILS_EXPORT LogConsoleSink : public LogSink {
+
+    public:
+        LogConsoleSink (const bool useAnsiSgrCodes = false,
+                        const Loglevel level = LoglevelTrace);
+
+        void write (const LogSinkRecord &record);
+        void flush ();
+
+    private:
+        bool _colorOutput;
+        bool _colorError;
+        std::string _line;
+    };
+
+    /**
+     @brief Writes lines with timestamp into a file.
+     @details The file stays open while the sink exists, buffering is done
+     according to the flush policy. The lines of a batch are written with a
+     single write (and synchronized once if the policy says so).
+     */
+    class RGPUTILS_EXPORT LogFileSink : public LogSink {
+
+    public:
+        /** @throw LogException if the file can't be opened. */
+        LogFileSink (const std::string &path,
+                     const LogFlushPolicy &policy = LogFlushPolicy(),
+                     const Loglevel level = LoglevelTrace);
+        ~LogFileSink ();
+
+        void write (const LogSinkRecord &record);
+        void flush ();
+        void flushIfDue ();
+        void beginBatch ();
+        void endBatch ();
+
+    private:
+        std::unique_ptr<LogFile> _file;
+    };
+
+    /**
+     @brief Writes lines with timestamp into a file through io_uring (Linux).
+     @details Lines are collected in a few large buffers that are registered
+     with the kernel. Full buffers and the rest of each batch of the
+     asynchronous mode are submitted as writes to the registered file without
+     waiting, so several writes are in flight and a batch costs about one
+     system call. Outside of batches every line is submitted on its own, use
+     it together with Log::setUseAsyncMode(). Where io_uring isn't available
+     (other systems, kernels before 5.1, kernels before 5.6 if the buffers
+     can't be registered, forbidden by seccomp) a writer thread writes the
+     buffers instead. If io_uring fails later on, the buffers in flight are
+     written directly and the writer thread takes over.
+     */
+    class RGPUTILS_EXPORT LogUringFileSink : public LogSink {
+
+    public:
+        /** @throw LogException if the file can't be opened. */
+        LogUringFileSink (const std::string &path,
+                          const size_t bufferSize = 256 * 1024,
+                          const size_t bufferCount = 8,
+                          const Loglevel level = LoglevelTrace);
+        ~LogUringFileSink ();
+
+        void write (const LogSinkRecord &record);
+        void flush ();
+        void flushIfDue ();
+        void beginBatch ();
+        void endBatch ();
+
+        /** True if io_uring is used, false if the writer thread is used. */
+        bool usesIoUring () const;
+
+    private:
+        std::unique_ptr<LogUringFile> _file;
+        bool _batching { false };
+    };
+
+    /**
+     @brief Writes lines with timestamp into a memory mapped file.
+     @details See Log::useMappedLogfile() for the layout of the file.
+     */
+    class RGPUTILS_EXPORT LogMappedFileSink : public LogSink {
+
+    public:
+        /** @throw LogException if the file can't be created or memory mapped
+         files are not supported. */
+        LogMappedFileSink (const std::string &path,
+                           const size_t segmentSize = 16 * 1024 * 1024,
+                           const Loglevel level = LoglevelTrace);
+        ~LogMappedFileSink ();
+
+        void write (const LogSinkRecord &record);
+
+    private:
+        std::unique_ptr<LogMappedFile> _file;
+    };
+
+    /**
+     @brief Sends each message as a syslog datagram to a unix socket.
+     @details Messages are sent as "<priority>identifier: message" with the
+     user facility, the local syslog daemon adds time and host. Messages
+     are dropped if the daemon can't keep up. Not available on Windows.
+     */
+    class RGPUTILS_EXPORT LogSocketSink : public LogSink {
+
+    public:
+        /** @throw LogException if the socket can't be connected. */
+        LogSocketSink (const std::string &socketPath = "/dev/log",
+                       const std::string &identifier = "",
+                       const Loglevel level = LoglevelTrace);
+        ~LogSocketSink ();
+
+        void write (const LogSinkRecord &record);
+
+    private:
+        int _socket { -1 };
+        std::string _identifier;
+        std::string _datagram;
+    };
+
+    /**
+     @brief Keeps the most recent lines in memory.
+     @details Useful to attach the last messages to a crash report or to
+     show them in an user interface.
+     */
+    class RGPUTILS_EXPORT LogMemorySink : public LogSink {
+
+    public:
+        LogMemorySink (const size_t capacity = 1024,
+                       const Loglevel level = LoglevelTrace);
+
+        void write (const LogSinkRecord &record);
+
+        /** The kept lines with timestamp (oldest first, no newlines). */
+        std::vector<std::string> lines () const;
+
+        /** Forgets all kept lines. */
+        void clear ();
+
+    private:
+        size_t _capacity;
+        mutable std::mutex _mutex;
+        std::deque<std::string> _lines;
+    };
+}
+
+#endif // defined(__RGPUtils__LogSink_H__) header guard
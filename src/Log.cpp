@@ -25,26 +25,279 @@
 */
 
 #include <rgp/Log.h>
+#include <rgp/LogMetrics.h>
+#include <rgp/LogSink.h>
+
+#include "LogBinaryFormat.h"
+#include "LogCompressor.h"
+#include "LogConfigSnapshot.h"
+#include "LogConsole.h"
+#include "LogFile.h"
+#include "LogFlightRecorder.h"
+#include "LogHistogram.h"
+#include "LogMappedFile.h"
+#include "LogRecord.h"
+#include "LogRingBuffer.h"
+#include "LogSampler.h"
+#include "LogThreadBuffer.h"
+#include "LogTimestamp.h"
 
 #include <iostream> // cout / cerr / cin ...
-#include <sstream>  // stringstream
-#include <fstream>  // file writing
-#include <ctime>    // adding date to log file
 #include <cstring>  // strerror
+#include <chrono>   // writer thread timeouts
+#include <algorithm> // std::find / std::min
+#include <fstream>  // metrics file
+#include <cstdlib>  // atexit
 
 using namespace rgp;
 
 // init instance to nullptr
-Log *Log::_sharedInstance = nullptr;
+std::atomic<Log *> Log::_sharedInstance { nullptr };
+
+// guards the creation of the shared instance
+static std::once_flag sharedInstanceOnce;
 
 Log *Log::sharedLog () {
     
-    // if first used -> alloc instance
-    if (_sharedInstance == nullptr) {
-        _sharedInstance = new Log();
+    // fast path: a single load once the instance exists
+    Log *log = _sharedInstance.load(std::memory_order_acquire);
+    if (log != nullptr) {
+        return log;
+    }
+    
+    // if first used -> alloc instance (other threads wait for it)
+    std::call_once(sharedInstanceOnce, [] {
+        _sharedInstance.store(new Log(), std::memory_order_release);
+        std::atexit(&Log::shutdownAtExit);
+    });
+    
+    return _sharedInstance.load(std::memory_order_acquire);
+}
+
+bool Log::shutdown (const unsigned int timeout)
+{
+    Log *log = _sharedInstance.load(std::memory_order_acquire);
+    if (log == nullptr) {
+        return true;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    // what is left of the timeout (0 = forever, at least 1 ms otherwise)
+    auto remaining = [timeout, start] () -> unsigned int {
+        if (timeout == 0) {
+            return 0;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        return elapsed < timeout ? timeout - (unsigned int)elapsed : 1;
+    };
+    
+    bool complete = true;
+    
+    log->writePendingSummaries();
+    log->handOverThreadBuffers(false);
+    
+    {
+        std::lock_guard<std::mutex> control(log->_controlMutex);
+        
+        if (log->_useAsyncMode) {
+            // new messages will be written directly from now on
+            log->_useAsyncMode = false;
+            log->stopAsyncWriter(remaining());
+        }
+        
+        // also true for a writer thread left running by an earlier call
+        {
+            std::lock_guard<std::mutex> lock(log->_asyncMutex);
+            complete = !log->_asyncStop || log->_asyncStopped;
+        }
+        
+        std::unique_lock<std::mutex> lock(log->_flushMutex);
+        log->stopFlushThread(lock);
+    }
+    
+    // the writer thread still holds the outputs
+    if (!complete) {
+        return false;
+    }
+    
+    log->flushFiles();
+    
+    {
+        // lines logged in the meantime go to the other outputs
+        std::lock_guard<std::mutex> lock(log->_cout_mutex);
+        log->_hasMappedLogfile = false;
+        log->_mappedFile->close();
+    }
+    
+    // rotated files are compressed by the background thread
+    if (!log->_compressor->wait(remaining())) {
+        complete = false;
+    }
+    
+    return complete;
+}
+
+// shuts the instance down when the process exits
+void Log::shutdownAtExit ()
+{
+    shutdown();
+}
+
+// maximum number of records the writer thread handles at once
+static const size_t kAsyncBatchSize = 256;
+
+// number of call sites messages logged as text are grouped into by the rate
+// limit and how often their summaries are written
+static const size_t kTextSiteCount = 256;
+static const unsigned int kSummaryInterval = 1000;
+
+namespace rgp {
+    
+    // owns the buffer of the current thread, hands it over on thread exit
+    struct LogThreadBufferHolder {
+        
+        LogThreadBuffer *buffer { nullptr };
+        
+        ~LogThreadBufferHolder () {
+            if (buffer != nullptr) {
+                Log::sharedLog()->releaseThreadBuffer(buffer);
+            }
+        }
+    };
+}
+
+static thread_local LogThreadBufferHolder threadBufferHolder;
+
+// the record of each thread, its text keeps the memory between log calls
+struct LogThreadRecord {
+    LogRecord record;
+    bool inUse { false };
+};
+
+static thread_local LogThreadRecord threadRecord;
+
+// borrows the record of the thread (or a new one if it is already in use,
+// f.e. if logging is called while a record is written)
+class LogRecordScope {
+    
+public:
+    LogRecordScope () : _owner(!threadRecord.inUse)
+    {
+        if (_owner) {
+            threadRecord.inUse = true;
+            
+            LogRecord &record = threadRecord.record;
+            record.kind = LogRecordKindOutput;
+            record.level = LoglevelNormal;
+            record.fgcolor = AnsiSgrFgColorDefault;
+            record.bgcolor = AnsiSgrBgColorDefault;
+            record.timestamp = 0;
+            record.ticket = 0;
+            record.structured = false;
+            record.text.clear();
+        }
+    }
+    
+    ~LogRecordScope ()
+    {
+        if (_owner) {
+            threadRecord.inUse = false;
+        }
+    }
+    
+    LogRecordScope (const LogRecordScope &) = delete;
+    LogRecordScope &operator = (const LogRecordScope &) = delete;
+    
+    LogRecord &record ()
+    {
+        return _owner ? threadRecord.record : _record;
+    }
+    
+private:
+    bool _owner;
+    LogRecord _record;
+};
+
+Log::Log () : _logFile(new LogFile()), _errorFile(new LogFile()),
+               _binaryFile(new LogFile()), _mappedFile(new LogMappedFile()),
+               _compressor(new LogCompressor()),
+               _outputLatency(new LogHistogram()),
+               _errorLatency(new LogHistogram()),
+               _textSites(new LogSite[kTextSiteCount]()),
+               _sampler(new LogSampler()),
+               _flightRecorder(new LogFlightRecorder())
+{
+    for (auto &count : _droppedMessages) {
+        count = 0;
+    }
+    for (auto &count : _lineCounts) {
+        count = 0;
+    }
+    for (auto &count : _byteCounts) {
+        count = 0;
+    }
+    
+    _configs.emplace_back(new LogConfigSnapshot());
+    _config = _configs.back().get();
+}
+
+Log::~Log ()
+{
+    setUseAsyncMode(false);
+    delete _asyncQueue.load();
+    
+    {
+        std::lock_guard<std::mutex> control(_controlMutex);
+        std::unique_lock<std::mutex> lock(_flushMutex);
+        stopFlushThread(lock);
     }
     
-    return _sharedInstance;
+    flushFiles();
+}
+
+// the current snapshot (never null)
+inline LogConfigRef Log::config () const
+{
+    return LogConfigRef(_config, _configEpoch);
+}
+
+// a copy of the current snapshot to change (_configMutex is locked)
+LogConfigSnapshot &Log::copyConfig ()
+{
+    _configs.emplace_back(new LogConfigSnapshot(*_config.load()));
+    _configs.back()->retiredEpoch = 0;
+    return *_configs.back();
+}
+
+// makes the last copy the current snapshot and frees the replaced snapshots
+// nobody reads anymore (_configMutex is locked)
+void Log::publishConfig ()
+{
+    const LogConfigSnapshot *replaced = _config.load();
+    
+    // sequentially consistent, pairs with the LogConfigRef constructor: a
+    // thread that still reads the replaced snapshot announced an epoch below
+    // the retired epoch before it loaded the pointer
+    _config.store(_configs.back().get());
+    uint64_t epoch = _configEpoch.fetch_add(1) + 1;
+    
+    uint64_t oldest = oldestLogConfigEpoch();
+    
+    auto it = _configs.begin();
+    while (it != _configs.end()) {
+        
+        if (it->get() == replaced) {
+            (*it)->retiredEpoch = epoch;
+        }
+        
+        if ((*it)->retiredEpoch != 0 && (*it)->retiredEpoch <= oldest) {
+            it = _configs.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 Loglevel Log::loglevel () const
@@ -54,85 +307,237 @@ Loglevel Log::loglevel () const
 
 void Log::setLoglevel (const Loglevel level)
 {
+    std::lock_guard<std::mutex> lock(_categoriesMutex);
+    
     _logLevel = level;
+    
+    // categories without an own level follow
+    for (auto &category : _categories) {
+        if (!category->_hasOwnLevel) {
+            category->_level.store(level, std::memory_order_relaxed);
+        }
+    }
+}
+
+LogCategory &Log::category (const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(_categoriesMutex);
+    
+    for (auto &category : _categories) {
+        if (category->_name == name) {
+            return *category;
+        }
+    }
+    
+    _categories.emplace_back(new LogCategory(this, name, _logLevel));
+    _categories.back()->_sampler->setPolicy(_samplingPolicy);
+    return *_categories.back();
+}
+
+void Log::setSamplingPolicy (const LogSamplingPolicy &policy)
+{
+    std::lock_guard<std::mutex> lock(_categoriesMutex);
+    
+    _samplingPolicy = policy;
+    _sampler->setPolicy(policy);
+    
+    // categories without an own policy follow
+    for (auto &category : _categories) {
+        if (!category->_hasOwnSampling) {
+            category->_samplingPolicy = policy;
+            category->_sampler->setPolicy(policy);
+        }
+    }
+    
+    updateSampling();
+}
+
+LogSamplingPolicy Log::samplingPolicy () const
+{
+    std::lock_guard<std::mutex> lock(_categoriesMutex);
+    return _samplingPolicy;
+}
+
+// asks the sampler
+bool Log::keepSample (LogSampler &sampler)
+{
+    return sampler.keep();
+}
+
+// recalculates _isSampling (_categoriesMutex is locked)
+void Log::updateSampling ()
+{
+    bool isSampling = _sampler->isActive();
+    for (auto &category : _categories) {
+        isSampling = isSampling || category->_sampler->isActive();
+    }
+    
+    _isSampling.store(isSampling, std::memory_order_relaxed);
+}
+
+// sets the sampling of a category (or lets it follow the Log)
+void Log::setCategorySamplingPolicy (LogCategory &category,
+                                     const LogSamplingPolicy &policy,
+                                     const bool followLog)
+{
+    std::lock_guard<std::mutex> lock(_categoriesMutex);
+    
+    category._hasOwnSampling = !followLog;
+    category._samplingPolicy = followLog ? _samplingPolicy : policy;
+    category._sampler->setPolicy(category._samplingPolicy);
+    
+    updateSampling();
+}
+
+// the sampling of a category
+LogSamplingPolicy Log::categorySamplingPolicy (const LogCategory &category) const
+{
+    std::lock_guard<std::mutex> lock(_categoriesMutex);
+    return category._samplingPolicy;
+}
+
+// sets the level of a category (or lets it follow the Log)
+void Log::setCategoryLoglevel (LogCategory &category, const Loglevel level,
+                               const bool followLog)
+{
+    std::lock_guard<std::mutex> lock(_categoriesMutex);
+    
+    category._hasOwnLevel = !followLog;
+    category._level.store(followLog ? _logLevel.load() : level,
+                          std::memory_order_relaxed);
+}
+
+// logs a text for a category (the level is already checked)
+void Log::logCategory (const LogCategory &category, const Loglevel level,
+                       const bool output, const LogStringRef text,
+                       const AnsiSgrFgColor fgcolor,
+                       const AnsiSgrBgColor bgcolor)
+{
+    // the same text of another category is another message
+    if (!admitText(level, text, (uint64_t)(uintptr_t)&category)) {
+        return;
+    }
+    
+    LogRecordScope scope;
+    LogRecord &record = scope.record();
+    record.kind = level == LoglevelError ? LogRecordKindError
+                                         : LogRecordKindOutput;
+    record.level = level;
+    record.fgcolor = fgcolor;
+    record.bgcolor = bgcolor;
+    record.timestamp = LogTimestamp::now();
+    
+    record.text.push_back('[');
+    record.text.append(category.name());
+    record.text.append("] ");
+    record.text.append(text.data(), text.size());
+    
+    if (isRecorded(level)) {
+        recordFlight(record, record.text.data(), record.text.size());
+    }
+    if (output) {
+        submit(record);
+    }
+}
+
+// logs a format string for a category (the level is already checked)
+void Log::logCategoryFormat (const LogCategory &category, const Loglevel level,
+                             const bool output, const char *format,
+                             const LogArgument *arguments, const size_t count)
+{
+    // the same format string of another category is another call site
+    if (!admitFormat(level, format, arguments, count,
+                     (uint64_t)(uintptr_t)&category)) {
+        return;
+    }
+    
+    LogRecordScope scope;
+    LogRecord &record = scope.record();
+    record.kind = level == LoglevelError ? LogRecordKindError
+                                         : LogRecordKindOutput;
+    record.level = level;
+    record.timestamp = LogTimestamp::now();
+    
+    record.text.push_back('[');
+    record.text.append(category.name());
+    record.text.append("] ");
+    formatLogMessage(record.text, format, arguments, count);
+    
+    if (isRecorded(level)) {
+        recordFlight(record, record.text.data(), record.text.size());
+    }
+    if (output) {
+        submit(record);
+    }
+}
+
+LogCategory::LogCategory (Log *log, const std::string &name,
+                          const Loglevel level)
+: _level(level), _log(log), _name(name), _sampler(new LogSampler())
+{
+}
+
+LogCategory::~LogCategory ()
+{
 }
 
 // verbose level 1 print
-void Log::printv (const std::string text, const AnsiSgrFgColor fgcolor,
+void Log::printv (const LogStringRef text, const AnsiSgrFgColor fgcolor,
                   const AnsiSgrBgColor bgcolor)
 {
-    if (_logLevel >= LoglevelVerbose) {
-        print(text, fgcolor, bgcolor);
-    }
+    log(LoglevelVerbose, text, fgcolor, bgcolor);
 }
 
 // normal print
-void Log::print (const std::string text, const AnsiSgrFgColor fgcolor,
+void Log::print (const LogStringRef text, const AnsiSgrFgColor fgcolor,
                  const AnsiSgrBgColor bgcolor)
 {
-    if (_logLevel >= LoglevelNormal) {
+    log(LoglevelNormal, text, fgcolor, bgcolor);
+}
+
+// print with a given level
+void Log::log (const Loglevel level, const LogStringRef text,
+               const AnsiSgrFgColor fgcolor, const AnsiSgrBgColor bgcolor)
+{
+    bool output = isEnabled(level) && isSampled(level, *_sampler);
+    bool recorded = isRecorded(level);
+    
+    if ((output || recorded) && admitText(level, text)) {
         
-        _cout_mutex.lock();
+        LogRecordScope scope;
+        LogRecord &record = scope.record();
+        record.kind = level == LoglevelError ? LogRecordKindError
+                                             : LogRecordKindOutput;
+        record.level = level;
+        record.fgcolor = fgcolor;
+        record.bgcolor = bgcolor;
+        record.timestamp = LogTimestamp::now();
+        record.text.append(text.data(), text.size());
         
-        // use log file if possible
-        if (_hasLogfile) {
-            
-            // open log file
-            std::ofstream file;
-            file.open(_logFilePath, std::ios::app);
-            
-            // write output to file
-            if (file.is_open()) {
-                
-                // add time to file
-                time_t timestamp = time(NULL); // get time now
-                tm *current_time = localtime( &timestamp );
-                file
-                << (current_time->tm_year + 1900) << '-'
-                << (current_time->tm_mon + 1) << '-'
-                <<  current_time->tm_mday << ' '
-                <<  current_time->tm_hour << ':'
-                <<  current_time->tm_min << ':'
-                <<  current_time->tm_sec << ' ';
-                
-                // append text
-                file << text << std::endl;
-            }
-            
-            // close log file
-            file.close();
-            
-        } else {
-            
-            // TODO: check if terminal supports ansi colors
-            if (_useAnsiSgrCodes)
-                std::cout << createSelectGraphicRenditionCode(fgcolor, bgcolor);
-            
-            // output to stdout
-            std::cout << text << std::endl << std::flush;
-            
-            // reset colors to default
-            if (_useAnsiSgrCodes)
-                std::cout << resetSelectGraphicRenditionCode();
+        if (recorded) {
+            recordFlight(record, record.text.data(), record.text.size());
+        }
+        if (output) {
+            submit(record);
         }
-        
-        _cout_mutex.unlock();
     }
 }
 
 // outputs text and reads line from stdin
 std::string Log::getline (const std::string text)
 {
-    char line_c[1024];
+    // one prompt at a time
+    std::lock_guard<std::mutex> input(_inputMutex);
     
-    _cout_mutex.lock();
+    showPrompt(text);
     
-    std::cout << text << std::flush;
-    std::cin.getline(line_c, 1024);
+    // other threads keep logging while this one waits for the input
+    std::string line;
+    std::getline(std::cin, line);
     
-    _cout_mutex.unlock();
+    releaseLogConsole();
     
-    return std::string { line_c };
+    return line;
 }
 
 // outputs text and reads one character from stdin
@@ -140,129 +545,1649 @@ char Log::getc (const std::string text)
 {
     char c = ' ';
     
-    _cout_mutex.lock();
+    std::lock_guard<std::mutex> input(_inputMutex);
     
-    std::cout << text << std::flush;
+    showPrompt(text);
     std::cin >> c;
     
-    _cout_mutex.unlock();
+    releaseLogConsole();
     
     return c;
 }
 
-// error print
-void Log::error (const std::string text)
+// writes the prompt and holds the console output until the input was read
+void Log::showPrompt (const std::string &text)
 {
-    _cerr_mutex.lock();
-    
-    // use log file if possible
-    if (_hasErrorfile) {
-        
-        // open log file
-        std::ofstream file;
-        file.open(_errorFilePath, std::ios::app);
-        
-        // write output to file
-        if (file.is_open()) {
-            
-            // add time to file
-            time_t timestamp = time(NULL); // get time now
-            tm *current_time = localtime( &timestamp );
-            file
-            << (current_time->tm_year + 1900) << '-'
-            << (current_time->tm_mon + 1) << '-'
-            <<  current_time->tm_mday << ' '
-            <<  current_time->tm_hour << ':'
-            <<  current_time->tm_min << ':'
-            <<  current_time->tm_sec << ' ';
-            
-            // append text
-            file << text << std::endl;
-        }
-        
-        // close log file
-        file.close();
-        
-    } else {
-        
-        // output to stderr
-        std::cerr << text << std::endl << std::flush;
-    }
+    // the prompt is written after the line that is being written
+    std::lock_guard<std::mutex> lock(_cout_mutex);
     
-    _cerr_mutex.unlock();
+    writeLogConsole(false, text.data(), text.size());
+    holdLogConsole();
+}
+
+// error print
+void Log::error (const LogStringRef text)
+{
+    log(LoglevelError, text);
 }
 
 // error print with error number (errno)
-void Log::errorWithErrno (const std::string text, const int err)
+void Log::errorWithErrno (const LogStringRef text, const int err)
 {
-    // create error string with text + errno
-    std::string error_string { text };
-    error_string += " ";
-    error_string += strerror(err);
+    bool output = isEnabled(LoglevelError);
+    bool recorded = isRecorded(LoglevelError);
+    
+    if ((!output && !recorded) || !admitText(LoglevelError, text, (uint64_t)err)) {
+        return;
+    }
+    
+    // error string with text + errno
+    LogRecordScope scope;
+    LogRecord &record = scope.record();
+    record.kind = LogRecordKindError;
+    record.level = LoglevelError;
+    record.timestamp = LogTimestamp::now();
+    record.text.append(text.data(), text.size());
+    record.text.push_back(' ');
+    record.text.append(strerror(err));
     
-    // output error with errno error string
-    error( error_string );
+    if (recorded) {
+        recordFlight(record, record.text.data(), record.text.size());
+    }
+    if (output) {
+        submit(record);
+    }
 }
 
 // using log file for print
 void Log::useLogfile (const std::string filePath)
 {
-    _logFilePath = filePath;
+    LogFlushPolicy policy = flushPolicy();
+    LogRotationPolicy rotation = rotationPolicy();
     
-    // check if file is usable
-    std::ofstream file;
-    file.open(_logFilePath, std::ios::app);
-    if (file.is_open()) {
-        _hasLogfile = true;
-    }
-    file.close();
+    std::lock_guard<std::mutex> lock(_cout_mutex);
+    
+    // the file stays open until another logfile is set
+    _logFile->setFlushPolicy(policy);
+    _logFile->setRotationPolicy(rotation, _compressor.get());
+    _hasLogfile = _logFile->open(filePath);
 }
 
 // using error file
 void Log::useErrorfile (const std::string filePath)
 {
-    _errorFilePath = filePath;
+    LogFlushPolicy policy = flushPolicy();
+    LogRotationPolicy rotation = rotationPolicy();
     
-    // check if file is usable
-    std::ofstream file;
-    file.open(_errorFilePath, std::ios::app);
-    if (file.is_open()) {
-        _hasErrorfile = true;
+    std::lock_guard<std::mutex> lock(_cerr_mutex);
+    
+    // the file stays open until another errorfile is set
+    _errorFile->setFlushPolicy(policy);
+    _errorFile->setRotationPolicy(rotation, _compressor.get());
+    _hasErrorfile = _errorFile->open(filePath);
+}
+
+// using binary log file for call sites
+void Log::useBinaryLogfile (const std::string filePath)
+{
+    LogFlushPolicy policy = flushPolicy();
+    
+    // no new format ids while the header is written
+    std::lock_guard<std::mutex> formatsLock(_formatsMutex);
+    std::lock_guard<std::mutex> lock(_cout_mutex);
+    
+    _hasBinaryLogfile = false;
+    _binaryFile->close();
+    
+    if (filePath.empty()) {
+        return;
+    }
+    
+    _binaryFile->setFlushPolicy(policy);
+    if (!_binaryFile->open(filePath)) {
+        return;
+    }
+    
+    // a new session starts with the header and all known formats
+    std::string header { kLogBinaryMagic, sizeof(kLogBinaryMagic) };
+    for (size_t i = 0; i < _formats.size(); i++) {
+        encodeLogBinaryFormat(header, (uint32_t)(i + 1), _formats[i]);
+    }
+    _binaryFile->append(header);
+    _binaryFile->endLine(false);
+    
+    _hasBinaryLogfile = true;
+}
+
+// using memory mapped log file for print
+void Log::useMappedLogfile (const std::string filePath, const size_t segmentSize)
+{
+    if (!LogMappedFile::isSupported()) {
+        throw LogException("memory mapped logfiles are not supported");
+    }
+    
+    std::lock_guard<std::mutex> lock(_cout_mutex);
+    
+    // lines logged in the meantime go to the other outputs
+    _hasMappedLogfile = false;
+    _mappedFile->close();
+    
+    if (filePath.empty()) {
+        return;
     }
-    file.close();
+    
+    _hasMappedLogfile = _mappedFile->open(filePath, segmentSize);
 }
 
-void Log::setUseAnsiSgrCodes (const bool useAnsiSgrCodes)
+void Log::useFlightRecorder (const LogFlightRecorderPolicy &policy,
+                             const std::string &dumpPath)
 {
-    _cout_mutex.lock();
-    _cerr_mutex.lock();
+    std::lock_guard<std::mutex> control(_controlMutex);
+    
+    if (!_flightRecorder->setDumpPath(dumpPath)) {
+        throw LogException("can't open flight recorder dump file " + dumpPath);
+    }
+    
+    _flightRecorderPolicy = policy;
     
-    _useAnsiSgrCodes = useAnsiSgrCodes;
+    bool enabled = policy.bufferSize > 0;
+    _recordLevel = enabled ? policy.level : LoglevelOff;
+    _dumpOnError = enabled && policy.dumpOnError;
+    _flightRecorder->setBufferSize(policy.bufferSize);
+    _flightRecorder->setDumpOnSignal(enabled && policy.dumpOnSignal);
+}
 
-    _cerr_mutex.unlock();
-    _cout_mutex.unlock();
+LogFlightRecorderPolicy Log::flightRecorderPolicy () const
+{
+    std::lock_guard<std::mutex> control(_controlMutex);
+    return _flightRecorderPolicy;
 }
 
-bool Log::useAnsiSgrCodes () const
+void Log::dumpFlightRecorder ()
+{
+    _flightRecorder->dump();
+}
+
+// writes a record into the flight recorder of the calling thread and dumps
+// it on errors if requested
+void Log::recordFlight (const LogRecord &record, const char *text,
+                        const size_t size)
+{
+    char prefix[LogTimestamp::kMaxLength];
+    size_t length = formatPrefix(record, prefix);
+    
+    _flightRecorder->record(prefix, length, text, size);
+    
+    if (record.level == LoglevelError &&
+        _dumpOnError.load(std::memory_order_relaxed)) {
+        _flightRecorder->dump();
+    }
+}
+
+void Log::addSink (const std::shared_ptr<LogSink> &sink)
+{
+    if (!sink) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(_sinksMutex);
+    _sinks.push_back(sink);
+    _sinkLatencies.emplace_back(new LogHistogram());
+    _hasSinks = true;
+}
+
+void Log::removeSink (const std::shared_ptr<LogSink> &sink)
+{
+    std::lock_guard<std::mutex> lock(_sinksMutex);
+    
+    auto it = std::find(_sinks.begin(), _sinks.end(), sink);
+    if (it == _sinks.end()) {
+        return;
+    }
+    
+    (*it)->flush();
+    _sinkLatencies.erase(_sinkLatencies.begin() + (it - _sinks.begin()));
+    _sinks.erase(it);
+    _hasSinks = !_sinks.empty();
+}
+
+void Log::removeAllSinks ()
 {
-    return _useAnsiSgrCodes;
+    std::lock_guard<std::mutex> lock(_sinksMutex);
+    
+    for (auto &sink : _sinks) {
+        sink->flush();
+    }
+    _sinks.clear();
+    _sinkLatencies.clear();
+    _hasSinks = false;
 }
 
-// creates ANSI SGR Code for given foreground and background colors
-std::string Log::createSelectGraphicRenditionCode(const AnsiSgrFgColor fgcolor,
-                                                  const AnsiSgrBgColor bgcolor)
+void Log::setFlushPolicy (const LogFlushPolicy &policy)
 {
-    std::stringstream sgr;
-    if (fgcolor != AnsiSgrFgColorDefault || bgcolor != AnsiSgrBgColorDefault) {
-        sgr << "\033[" << fgcolor << ";" << bgcolor << "m";
+    std::lock_guard<std::mutex> control(_controlMutex);
+    std::unique_lock<std::mutex> lock(_flushMutex);
+    
+    _flushPolicy = policy;
+    
+    // restart the flush thread with the new interval
+    restartFlushThread(lock);
+    
+    lock.unlock();
+    
+    {
+        std::lock_guard<std::mutex> coutLock(_cout_mutex);
+        _logFile->setFlushPolicy(policy);
+        _binaryFile->setFlushPolicy(policy);
+    }
+    {
+        std::lock_guard<std::mutex> cerrLock(_cerr_mutex);
+        _errorFile->setFlushPolicy(policy);
     }
-    return sgr.str();
 }
 
-// creates ANSI SGR Reset Code
-std::string Log::resetSelectGraphicRenditionCode()
+LogFlushPolicy Log::flushPolicy () const
+{
+    std::lock_guard<std::mutex> lock(_flushMutex);
+    return _flushPolicy;
+}
+
+void Log::setRotationPolicy (const LogRotationPolicy &policy)
 {
-    std::stringstream sgr;
-    sgr << "\033[0m";
-    return sgr.str();
+    LogRotationPolicy rotation = policy;
+    
+    // without zlib rotated files stay uncompressed
+    if (!LogCompressor::isAvailable()) {
+        rotation.compress = false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(_flushMutex);
+        _rotationPolicy = rotation;
+    }
+    {
+        std::lock_guard<std::mutex> coutLock(_cout_mutex);
+        _logFile->setRotationPolicy(rotation, _compressor.get());
+    }
+    {
+        std::lock_guard<std::mutex> cerrLock(_cerr_mutex);
+        _errorFile->setRotationPolicy(rotation, _compressor.get());
+    }
+}
+
+LogRotationPolicy Log::rotationPolicy () const
+{
+    std::lock_guard<std::mutex> lock(_flushMutex);
+    return _rotationPolicy;
+}
+
+void Log::setRateLimit (const LogRateLimit &limit)
+{
+    int64_t interval = 0;
+    if (limit.messagesPerSecond > 0) {
+        interval = std::max((int64_t)1, (int64_t)(1000000000.0 / limit.messagesPerSecond));
+    }
+    int64_t burst = limit.burst > 0 ? limit.burst : 1;
+    
+    {
+        std::lock_guard<std::mutex> lock(_configMutex);
+        
+        LogConfigSnapshot &config = copyConfig();
+        config.rateLimit = limit;
+        config.rateTolerance = interval * (burst - 1);
+        config.rateInterval = interval;
+        config.duplicateInterval = (int64_t)limit.duplicateInterval * 1000000;
+        publishConfig();
+    }
+    
+    // the flush thread writes the summaries of dropped messages
+    unsigned int summaryInterval = interval > 0 || limit.duplicateInterval > 0
+                                   ? kSummaryInterval : 0;
+    
+    std::lock_guard<std::mutex> control(_controlMutex);
+    std::unique_lock<std::mutex> lock(_flushMutex);
+    if (summaryInterval != _summaryInterval) {
+        _summaryInterval = summaryInterval;
+        restartFlushThread(lock);
+    }
+}
+
+LogRateLimit Log::rateLimit () const
+{
+    return config()->rateLimit;
+}
+
+void Log::setThreadBufferSize (const size_t bufferSize,
+                               const unsigned int interval)
+{
+    std::lock_guard<std::mutex> control(_controlMutex);
+    
+    _threadBufferSize = bufferSize;
+    
+    {
+        std::unique_lock<std::mutex> lock(_flushMutex);
+        _threadBufferInterval = bufferSize > 0 ? interval : 0;
+        restartFlushThread(lock);
+    }
+    
+    // output what was buffered before (or with the old size)
+    handOverThreadBuffers(false);
+}
+
+size_t Log::threadBufferSize () const
+{
+    return _threadBufferSize;
+}
+
+void Log::setTimestampPrecision (const LogTimestampPrecision precision)
+{
+    std::lock_guard<std::mutex> lock(_configMutex);
+    copyConfig().timestampPrecision = precision;
+    publishConfig();
+}
+
+LogTimestampPrecision Log::timestampPrecision () const
+{
+    return config()->timestampPrecision;
+}
+
+void Log::setUseAnsiSgrCodes (const bool useAnsiSgrCodes,
+                              const bool onlyOnTerminal)
+{
+    // pipes and files would only get the escape sequences as garbage
+    bool use = useAnsiSgrCodes && (!onlyOnTerminal || isLogConsoleTerminal(false));
+    
+    std::lock_guard<std::mutex> lock(_configMutex);
+    copyConfig().useAnsiSgrCodes = use;
+    publishConfig();
+}
+
+bool Log::useAnsiSgrCodes () const
+{
+    return config()->useAnsiSgrCodes;
+}
+
+void Log::setUseAsyncMode (const bool useAsyncMode, const size_t queueCapacity)
+{
+    std::lock_guard<std::mutex> control(_controlMutex);
+    
+    if (useAsyncMode == _useAsyncMode) {
+        return;
+    }
+    
+    if (useAsyncMode) {
+        
+        // a writer thread left running by shutdown() still uses the queue and
+        // the state of the writer thread
+        {
+            std::lock_guard<std::mutex> lock(_asyncMutex);
+            if (_asyncStop && !_asyncStopped) {
+                throw LogException("the writer thread of the asynchronous mode "
+                                   "is still running");
+            }
+        }
+        
+        // the queue is created only once, producers that still see an old
+        // state can always access it safely
+        if (_asyncQueue.load() == nullptr) {
+            _asyncQueue.store(new LogRingBuffer<LogRecord>(queueCapacity));
+        }
+        
+        _asyncStop = false;
+        _asyncStopped = false;
+        _asyncThread = std::thread(&Log::asyncWriterLoop, this);
+        _useAsyncMode = true;
+        
+    } else {
+        
+        // new messages will be written directly from now on
+        _useAsyncMode = false;
+        stopAsyncWriter(0);
+    }
+}
+
+// lets the writer thread drain the queue and waits for it
+// (_controlMutex is locked)
+bool Log::stopAsyncWriter (const unsigned int timeout)
+{
+    {
+        std::unique_lock<std::mutex> lock(_asyncMutex);
+        _asyncStop = true;
+        _asyncCondition.notify_one();
+        
+        if (timeout > 0 &&
+            !_asyncFlushCondition.wait_for(lock, std::chrono::milliseconds(timeout),
+                                           [this] { return _asyncStopped; })) {
+            // a sink may hang, don't block the caller (f.e. at exit) forever
+            _asyncThread.detach();
+            return false;
+        }
+    }
+    _asyncThread.join();
+    
+    // a producer may have enqueued after the writer thread quit
+    LogRingBuffer<LogRecord> *queue = _asyncQueue.load(std::memory_order_acquire);
+    LogRecord records[kAsyncBatchSize];
+    size_t count = 0;
+    while (count < kAsyncBatchSize && queue->tryPop(records[count])) {
+        count++;
+        if (count == kAsyncBatchSize) {
+            writeBatch(records, count);
+            count = 0;
+        }
+    }
+    writeBatch(records, count);
+    
+    return true;
+}
+
+bool Log::useAsyncMode () const
+{
+    return _useAsyncMode;
+}
+
+void Log::setAsyncOverflowPolicy (const LogOverflowPolicy policy,
+                                  const Loglevel level)
+{
+    std::lock_guard<std::mutex> lock(_configMutex);
+    
+    LogConfigSnapshot &config = copyConfig();
+    config.overflowPolicy = policy;
+    config.overflowLevel = level;
+    publishConfig();
+}
+
+LogOverflowPolicy Log::asyncOverflowPolicy () const
+{
+    return config()->overflowPolicy;
+}
+
+uint64_t Log::droppedMessages () const
+{
+    uint64_t dropped = 0;
+    for (auto &count : _droppedMessages) {
+        dropped += count.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+uint64_t Log::droppedMessages (const Loglevel level) const
+{
+    if (level > LoglevelTrace) {
+        return 0;
+    }
+    return _droppedMessages[level].load(std::memory_order_relaxed);
+}
+
+void Log::setCollectMetrics (const bool collect)
+{
+    _collectMetrics = collect;
+}
+
+bool Log::collectMetrics () const
+{
+    return _collectMetrics;
+}
+
+LogMetrics Log::metrics () const
+{
+    LogMetrics metrics;
+    metrics.timestamp = LogTimestamp::now();
+    
+    for (size_t level = 0; level <= LoglevelTrace; level++) {
+        metrics.lines[level] = _lineCounts[level].load(std::memory_order_relaxed);
+        metrics.bytes[level] = _byteCounts[level].load(std::memory_order_relaxed);
+        metrics.dropped[level] = _droppedMessages[level].load(std::memory_order_relaxed);
+    }
+    
+    metrics.flushes = _logFile->flushCount() + _errorFile->flushCount() +
+                      _binaryFile->flushCount();
+    
+    metrics.outputMutex.contended = _outputContended.load(std::memory_order_relaxed);
+    metrics.outputMutex.waitNanoseconds = _outputWait.load(std::memory_order_relaxed);
+    metrics.errorMutex.contended = _errorContended.load(std::memory_order_relaxed);
+    metrics.errorMutex.waitNanoseconds = _errorWait.load(std::memory_order_relaxed);
+    
+    // no control mutex here: it is held while the flush thread is joined,
+    // and the flush thread calls this method for the metrics dump
+    const LogRingBuffer<LogRecord> *queue = _asyncQueue.load(std::memory_order_acquire);
+    if (queue != nullptr) {
+        metrics.queueDepth = queue->size();
+        metrics.queueCapacity = queue->capacity();
+    }
+    
+    _outputLatency->snapshot(metrics.outputLatency);
+    _errorLatency->snapshot(metrics.errorLatency);
+    
+    {
+        std::lock_guard<std::mutex> lock(_sinksMutex);
+        metrics.sinks.resize(_sinks.size());
+        for (size_t i = 0; i < _sinks.size(); i++) {
+            metrics.sinks[i].sink = _sinks[i];
+            _sinkLatencies[i]->snapshot(metrics.sinks[i].writeLatency);
+        }
+    }
+    
+    return metrics;
+}
+
+void Log::resetMetrics ()
+{
+    for (size_t level = 0; level <= LoglevelTrace; level++) {
+        _lineCounts[level] = 0;
+        _byteCounts[level] = 0;
+    }
+    
+    _outputContended = 0;
+    _outputWait = 0;
+    _errorContended = 0;
+    _errorWait = 0;
+    
+    _outputLatency->reset();
+    _errorLatency->reset();
+    
+    std::lock_guard<std::mutex> lock(_sinksMutex);
+    for (auto &latency : _sinkLatencies) {
+        latency->reset();
+    }
+}
+
+void Log::setMetricsDump (const std::string &path, const unsigned int interval)
+{
+    std::lock_guard<std::mutex> control(_controlMutex);
+    
+    if (interval > 0) {
+        _collectMetrics = true;
+    }
+    
+    std::unique_lock<std::mutex> lock(_flushMutex);
+    _metricsPath = path;
+    _metricsInterval = path.empty() ? 0 : interval;
+    restartFlushThread(lock);
+}
+
+// counts a line that is written
+void Log::countLine (const LogRecord &record)
+{
+    size_t level = record.kind == LogRecordKindError ? LoglevelError
+                                                     : record.level;
+    if (level > LoglevelTrace) {
+        level = LoglevelTrace;
+    }
+    
+    _lineCounts[level].fetch_add(1, std::memory_order_relaxed);
+    _byteCounts[level].fetch_add(record.text.size(), std::memory_order_relaxed);
+}
+
+// locks a mutex and measures the time waited if it was locked
+void Log::lockMeasured (std::unique_lock<std::mutex> &lock,
+                        std::atomic<uint64_t> &contended,
+                        std::atomic<uint64_t> &wait)
+{
+    if (!_collectMetrics.load(std::memory_order_relaxed)) {
+        lock.lock();
+        return;
+    }
+    
+    // the clock is only read if the mutex is contended
+    if (lock.try_lock()) {
+        return;
+    }
+    
+    uint64_t start = LogHistogram::now();
+    lock.lock();
+    wait.fetch_add(LogHistogram::now() - start, std::memory_order_relaxed);
+    contended.fetch_add(1, std::memory_order_relaxed);
+}
+
+// appends a snapshot of the metrics to the dump file
+void Log::dumpMetrics (const std::string &path)
+{
+    std::ofstream file(path, std::ios::out | std::ios::app);
+    if (file.is_open()) {
+        file << metrics().toJson() << '\n';
+    }
+}
+
+void Log::flush ()
+{
+    writePendingSummaries();
+    handOverThreadBuffers(false);
+    
+    std::unique_lock<std::mutex> control(_controlMutex);
+    
+    if (!_useAsyncMode) {
+        control.unlock();
+        flushFiles();
+        return;
+    }
+    
+    // the flush record is queued behind all records logged before (the
+    // record of the thread, the queue hands its text buffer back)
+    LogRecordScope scope;
+    LogRecord &record = scope.record();
+    record.kind = LogRecordKindFlush;
+    {
+        std::lock_guard<std::mutex> lock(_asyncMutex);
+        record.ticket = ++_asyncFlushRequested;
+    }
+    const uint64_t ticket = record.ticket;
+    
+    enqueue(record);
+    
+    {
+        std::unique_lock<std::mutex> lock(_asyncMutex);
+        _asyncFlushCondition.wait(lock, [this, ticket] {
+            return _asyncFlushCompleted >= ticket;
+        });
+    }
+    
+    flushFiles();
+}
+
+// name of a level in structured records
+static const char *structuredLevelName (const Loglevel level)
+{
+    switch (level) {
+        case LoglevelError: return "error";
+        case LoglevelWarning: return "warning";
+        case LoglevelInfo: return "info";
+        case LoglevelDebug: return "debug";
+        case LoglevelTrace: return "trace";
+        default: return "off";
+    }
+}
+
+void Log::log (const Loglevel level, const char *message,
+               std::initializer_list<LogField> fields)
+{
+    log(level, message, fields.begin(), fields.size());
+}
+
+void Log::log (const Loglevel level, const char *message,
+               const LogField *fields, const size_t count)
+{
+    bool output = isEnabled(level) && isSampled(level, *_sampler);
+    bool recorded = isRecorded(level);
+    
+    if (!output && !recorded) {
+        return;
+    }
+    
+    LogRecordScope scope;
+    LogRecord &record = scope.record();
+    record.kind = level == LoglevelError ? LogRecordKindError
+                                         : LogRecordKindOutput;
+    record.level = level;
+    record.timestamp = LogTimestamp::now();
+    record.structured = true;
+    
+    LogConfigRef config = this->config();
+    
+    char time[LogTimestamp::kMaxLength];
+    size_t timeSize = LogTimestamp::formatIso8601(time, record.timestamp,
+                                                  config->timestampPrecision);
+    
+    encodeLogFields(record.text, config->structuredFormat, time, timeSize,
+                    structuredLevelName(level), message, strlen(message),
+                    fields, count);
+    
+    if (recorded) {
+        recordFlight(record, record.text.data(), record.text.size());
+    }
+    if (output) {
+        submit(record);
+    }
+}
+
+void Log::setStructuredFormat (const LogStructuredFormat format)
+{
+    std::lock_guard<std::mutex> lock(_configMutex);
+    copyConfig().structuredFormat = format;
+    publishConfig();
+}
+
+LogStructuredFormat Log::structuredFormat () const
+{
+    return config()->structuredFormat;
+}
+
+// applies the rate limit and logs a format string with arguments
+void Log::logFormat (const Loglevel level, const bool output,
+                     const char *format, const LogArgument *arguments,
+                     const size_t count)
+{
+    if (admitFormat(level, format, arguments, count)) {
+        writeFormat(level, output, format, arguments, count);
+    }
+}
+
+// formats and logs a format string with arguments
+void Log::writeFormat (const Loglevel level, const bool output,
+                       const char *format, const LogArgument *arguments,
+                       const size_t count)
+{
+    LogRecordScope scope;
+    LogRecord &record = scope.record();
+    record.kind = level == LoglevelError ? LogRecordKindError
+                                         : LogRecordKindOutput;
+    record.level = level;
+    record.timestamp = LogTimestamp::now();
+    formatLogMessage(record.text, format, arguments, count);
+    
+    if (isRecorded(level)) {
+        recordFlight(record, record.text.data(), record.text.size());
+    }
+    if (output) {
+        submit(record);
+    }
+}
+
+// hash of the arguments of a message (FNV-1a), never 0
+static uint64_t hashArguments (const LogArgument *arguments, const size_t count)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    
+    auto add = [&hash] (const char *data, const size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+        }
+    };
+    
+    for (size_t i = 0; i < count; i++) {
+        
+        const LogArgument &argument = arguments[i];
+        LogArgumentType type = argument.type();
+        add((const char *)&type, sizeof(type));
+        
+        if (type == LogArgumentTypeString) {
+            add(argument.stringData(), argument.stringSize());
+        } else {
+            uint64_t value = argument.uintValue();
+            add((const char *)&value, sizeof(value));
+        }
+    }
+    
+    return hash != 0 ? hash : 1;
+}
+
+// applies the rate limit of a call site, writes the summaries of dropped
+// messages and returns false if the message is dropped
+bool Log::admitSite (LogSite &site, const Loglevel level,
+                     const LogArgument *arguments, const size_t count)
+{
+    // interval, tolerance and duplicate interval always belong together
+    LogConfigRef config = this->config();
+    
+    if (config->duplicateInterval == 0 && config->rateInterval == 0) {
+        return true;
+    }
+    
+    uint64_t hash = config->duplicateInterval > 0 ? hashArguments(arguments, count)
+                                                  : 0;
+    return admitHash(site, level, hash, *config);
+}
+
+// applies the rate limit to a message logged as text
+bool Log::admitText (const Loglevel level, const LogStringRef text,
+                     const uint64_t seed)
+{
+    LogConfigRef config = this->config();
+    
+    if (config->duplicateInterval == 0 && config->rateInterval == 0) {
+        return true;
+    }
+    
+    uint64_t hash = 14695981039346656037ULL ^ seed;
+    for (size_t i = 0; i < text.size(); i++) {
+        hash = (hash ^ (unsigned char)text.data()[i]) * 1099511628211ULL;
+    }
+    hash = hash != 0 ? hash : 1;
+    
+    // texts of the same call site share its token bucket (the last bytes
+    // of the text only change the low bits of the hash)
+    LogSite &site = _textSites[(hash ^ (hash >> 32)) % kTextSiteCount];
+    return admitHash(site, level, hash, *config);
+}
+
+// applies the rate limit to a format string logged without a call site
+bool Log::admitFormat (const Loglevel level, const char *format,
+                       const LogArgument *arguments, const size_t count,
+                       const uint64_t seed)
+{
+    LogConfigRef config = this->config();
+    
+    if (config->duplicateInterval == 0 && config->rateInterval == 0) {
+        return true;
+    }
+    
+    // the address of the format string is the call site (string literals
+    // of one call are the same), the multiplication spreads it over all bits
+    uint64_t key = ((uint64_t)(uintptr_t)format ^ seed) * 1099511628211ULL;
+    LogSite &site = _textSites[(key ^ (key >> 32)) % kTextSiteCount];
+    
+    uint64_t hash = 0;
+    if (config->duplicateInterval > 0) {
+        hash = hashArguments(arguments, count) ^ key;
+        hash = hash != 0 ? hash : 1;
+    }
+    return admitHash(site, level, hash, *config);
+}
+
+// applies the rate limit with the hash of the message
+bool Log::admitHash (LogSite &site, const Loglevel level, const uint64_t hash,
+                     const LogConfigSnapshot &config)
+{
+    int64_t duplicateInterval = config.duplicateInterval;
+    int64_t rateInterval = config.rateInterval;
+    
+    int64_t now = LogTimestamp::now();
+    
+    // a repeated message only costs the hash and a counter
+    if (duplicateInterval > 0) {
+        
+        if (site.lastHash.load(std::memory_order_relaxed) == hash &&
+            now - site.lastTime.load(std::memory_order_relaxed) < duplicateInterval) {
+            countSiteDrop(site, level, site.repeated);
+            return false;
+        }
+        
+        site.lastHash.store(hash, std::memory_order_relaxed);
+        site.lastTime.store(now, std::memory_order_relaxed);
+    }
+    
+    // token bucket as generic cell rate algorithm: the bucket is empty if
+    // the next message is due later than the tolerated burst
+    if (rateInterval > 0) {
+        
+        int64_t tolerance = config.rateTolerance;
+        int64_t due = site.rateTime.load(std::memory_order_relaxed);
+        
+        for (;;) {
+            int64_t start = due > now ? due : now;
+            if (start - now > tolerance) {
+                countSiteDrop(site, level, site.suppressed);
+                return false;
+            }
+            if (site.rateTime.compare_exchange_weak(due, start + rateInterval,
+                                                    std::memory_order_relaxed)) {
+                break;
+            }
+        }
+    }
+    
+    // the dropped messages are summarized before the message
+    writeSiteSummaries(site, level);
+    
+    return true;
+}
+
+// counts a dropped message and remembers the call site for its summary
+void Log::countSiteDrop (LogSite &site, const Loglevel level,
+                         std::atomic<uint32_t> &counter)
+{
+    site.droppedLevel.store(level, std::memory_order_relaxed);
+    
+    // the first drop since the last summary remembers the site (pending is
+    // reset before the counters are taken, so a drop after that remembers
+    // the site again)
+    if (counter.fetch_add(1, std::memory_order_acq_rel) == 0 &&
+        !site.pending.exchange(true, std::memory_order_acq_rel)) {
+        std::lock_guard<std::mutex> lock(_pendingSitesMutex);
+        _pendingSites.push_back(&site);
+    }
+}
+
+// writes the summaries of the dropped messages of a call site
+void Log::writeSiteSummaries (LogSite &site, const Loglevel level)
+{
+    uint32_t repeated = site.repeated.load(std::memory_order_relaxed) > 0
+        ? site.repeated.exchange(0, std::memory_order_acq_rel) : 0;
+    if (repeated > 0) {
+        LogArgument argument { repeated };
+        writeFormat(level, isEnabled(level), "last message repeated {} times",
+                    &argument, 1);
+    }
+    
+    uint32_t suppressed = site.suppressed.load(std::memory_order_relaxed) > 0
+        ? site.suppressed.exchange(0, std::memory_order_acq_rel) : 0;
+    if (suppressed > 0) {
+        LogArgument argument { suppressed };
+        writeFormat(level, isEnabled(level),
+                    "{} messages suppressed by the rate limit", &argument, 1);
+    }
+}
+
+// writes the summaries of all call sites that dropped messages
+void Log::writePendingSummaries ()
+{
+    static thread_local std::vector<LogSite *> sites;
+    
+    {
+        std::lock_guard<std::mutex> lock(_pendingSitesMutex);
+        if (_pendingSites.empty()) {
+            return;
+        }
+        sites.swap(_pendingSites);
+    }
+    
+    for (LogSite *site : sites) {
+        site->pending.store(false, std::memory_order_release);
+        writeSiteSummaries(*site, (Loglevel)site->droppedLevel.load(std::memory_order_relaxed));
+    }
+    sites.clear();
+}
+
+// logs the format string and arguments of a call site
+void Log::logSite (LogSite &site, const Loglevel level, const bool output,
+                   const char *format, const LogArgument *arguments,
+                   const size_t count)
+{
+    const bool isError = level == LoglevelError;
+    
+    if (!admitSite(site, level, arguments, count)) {
+        return;
+    }
+    
+    LogRecordScope scope;
+    LogRecord &record = scope.record();
+    record.level = level;
+    record.timestamp = LogTimestamp::now();
+    
+    if (_hasBinaryLogfile.load(std::memory_order_acquire)) {
+        
+        // the flight recorder needs the text anyway
+        if (isRecorded(level)) {
+            static thread_local std::string text;
+            text.clear();
+            formatLogMessage(text, format, arguments, count);
+            recordFlight(record, text.data(), text.size());
+        }
+        if (!output) {
+            return;
+        }
+        
+        uint32_t id = site.formatId.load(std::memory_order_acquire);
+        if (id == 0) {
+            id = registerFormat(site, format);
+        }
+        
+        // only the raw arguments are written, no text is created
+        record.kind = LogRecordKindBinary;
+        encodeLogBinaryEvent(record.text, id, record.timestamp, level,
+                             isError ? kLogBinaryFlagError : 0,
+                             arguments, count);
+        
+        if (_collectMetrics.load(std::memory_order_relaxed)) {
+            countLine(record);
+        }
+        dispatch(record);
+        return;
+    }
+    
+    record.kind = isError ? LogRecordKindError : LogRecordKindOutput;
+    formatLogMessage(record.text, format, arguments, count);
+    
+    if (isRecorded(level)) {
+        recordFlight(record, record.text.data(), record.text.size());
+    }
+    if (output) {
+        submit(record);
+    }
+}
+
+// gives the format string of a call site an id
+uint32_t Log::registerFormat (LogSite &site, const char *format)
+{
+    std::lock_guard<std::mutex> lock(_formatsMutex);
+    
+    // another thread may have been faster
+    uint32_t id = site.formatId.load(std::memory_order_acquire);
+    if (id != 0) {
+        return id;
+    }
+    
+    _formats.push_back(format);
+    id = (uint32_t)_formats.size();
+    
+    // the format has to be in the binary logfile before the first event
+    // that uses it (another thread may log as soon as the id is set)
+    if (_hasBinaryLogfile) {
+        LogRecord record;
+        record.kind = LogRecordKindBinaryFormat;
+        encodeLogBinaryFormat(record.text, id, _formats.back());
+        dispatch(record);
+    }
+    
+    site.formatId.store(id, std::memory_order_release);
+    
+    return id;
+}
+
+// hands a record to the thread buffer, the writer thread or writes it directly
+void Log::submit (LogRecord &record)
+{
+    if (_collectMetrics.load(std::memory_order_relaxed)) {
+        countLine(record);
+    }
+    
+    // sinks replace all other text outputs
+    if (_hasSinks.load(std::memory_order_acquire)) {
+        dispatch(record);
+        return;
+    }
+    
+    // the memory mapped logfile needs no buffering
+    if (record.kind == LogRecordKindOutput &&
+        _hasMappedLogfile.load(std::memory_order_acquire) &&
+        writeMapped(record)) {
+        return;
+    }
+    
+    // format normal output into the buffer of this thread if enabled
+    if (record.kind == LogRecordKindOutput) {
+        size_t bufferSize = _threadBufferSize.load(std::memory_order_relaxed);
+        if (bufferSize > 0) {
+            bufferOutput(record, bufferSize);
+            return;
+        }
+    }
+    
+    dispatch(record);
+}
+
+// hands a record to the writer thread or writes it directly
+void Log::dispatch (LogRecord &record)
+{
+    if (_useAsyncMode.load(std::memory_order_acquire)) {
+        enqueue(record);
+        return;
+    }
+    
+    if ((record.kind == LogRecordKindOutput ||
+         record.kind == LogRecordKindError) &&
+        _hasSinks.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(_sinksMutex);
+        writeSinks(record);
+        return;
+    }
+    
+    if (record.kind == LogRecordKindError) {
+        std::unique_lock<std::mutex> lock(_cerr_mutex, std::defer_lock);
+        lockMeasured(lock, _errorContended, _errorWait);
+        writeError(record);
+    } else {
+        std::unique_lock<std::mutex> lock(_cout_mutex, std::defer_lock);
+        lockMeasured(lock, _outputContended, _outputWait);
+        writeOutput(record);
+    }
+}
+
+// true if a record may be dropped when the async queue is full
+static bool isDroppable (const LogRecord &record)
+{
+    return record.kind != LogRecordKindError &&
+           record.kind != LogRecordKindBinaryFormat &&
+           record.kind != LogRecordKindFlush &&
+           record.level != LoglevelError;
+}
+
+// the tag of a record in the async queue: its level, LoglevelOff if it must
+// never be dropped
+static uint8_t overflowTag (const LogRecord &record)
+{
+    return isDroppable(record) ? (uint8_t)record.level : (uint8_t)LoglevelOff;
+}
+
+// puts a record into the async queue (waits if the queue is full)
+void Log::enqueue (LogRecord &record)
+{
+    LogRingBuffer<LogRecord> *queue = _asyncQueue.load(std::memory_order_acquire);
+    
+    if (!queue->tryPush(record, overflowTag(record)) && !enqueueOverflow(record)) {
+        return;
+    }
+    
+    // only wake up the writer thread if it is really sleeping
+    // (the fence pairs with the one in asyncWriterLoop)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_asyncSleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(_asyncMutex);
+        _asyncCondition.notify_one();
+    }
+}
+
+// puts a record into the full async queue according to the overflow policy,
+// returns false if it was dropped
+bool Log::enqueueOverflow (LogRecord &record)
+{
+    LogConfigRef config = this->config();
+    LogRingBuffer<LogRecord> *queue = _asyncQueue.load(std::memory_order_acquire);
+    LogOverflowPolicy policy = config->overflowPolicy;
+    uint8_t tag = overflowTag(record);
+    
+    if (tag != LoglevelOff && (policy == LogOverflowPolicyDropNewest ||
+                               (policy == LogOverflowPolicyDropBelowLevel &&
+                                record.level > config->overflowLevel))) {
+        countDropped(record);
+        return false;
+    }
+    
+    // queued records more detailed than this level may be dropped to make
+    // space (none with LogOverflowPolicyBlock / LogOverflowPolicyDropNewest)
+    uint8_t dropAbove = LoglevelTrace;
+    if (policy == LogOverflowPolicyDropOldest) {
+        dropAbove = LoglevelError;
+    } else if (policy == LogOverflowPolicyDropBelowLevel) {
+        dropAbove = config->overflowLevel;
+    }
+    
+    static thread_local LogRecord oldest;
+    
+    while (!queue->tryPush(record, tag)) {
+        
+        // only the oldest record can be taken out, if it must be kept the
+        // writer thread has to make space (the order stays the same)
+        if (queue->tryPopIf(oldest, [dropAbove] (const uint8_t oldestTag) {
+                                        return oldestTag > dropAbove;
+                                    })) {
+            countDropped(oldest);
+        } else {
+            // queue is full -> give the writer thread some time
+            std::this_thread::yield();
+        }
+    }
+    return true;
+}
+
+// counts a record that was dropped
+void Log::countDropped (const LogRecord &record)
+{
+    // a chunk of a thread buffer holds several lines
+    uint64_t count = 1;
+    if (record.kind == LogRecordKindOutputChunk) {
+        count = (uint64_t)std::count(record.text.begin(), record.text.end(), '\n');
+    }
+    
+    size_t level = record.level <= LoglevelTrace ? record.level : LoglevelTrace;
+    _droppedMessages[level].fetch_add(count, std::memory_order_relaxed);
+}
+
+// main loop of the writer thread
+void Log::asyncWriterLoop ()
+{
+    std::unique_ptr<LogRecord[]> records { new LogRecord[kAsyncBatchSize] };
+    LogRingBuffer<LogRecord> *queue = _asyncQueue.load(std::memory_order_acquire);
+    
+    for (;;) {
+        
+        // take as much records as possible out of the queue
+        size_t count = 0;
+        while (count < kAsyncBatchSize && queue->tryPop(records[count])) {
+            count++;
+        }
+        
+        if (count > 0) {
+            writeBatch(records.get(), count);
+            continue;
+        }
+        
+        // queue is empty -> quit if requested
+        if (_asyncStop) {
+            break;
+        }
+        
+        // announce that we go to sleep and check the queue again, so a
+        // producer can't enqueue without seeing the flag
+        std::unique_lock<std::mutex> lock(_asyncMutex);
+        _asyncSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        
+        if (queue->size() == 0 && !_asyncStop) {
+            _asyncCondition.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        
+        _asyncSleeping.store(false, std::memory_order_relaxed);
+    }
+    
+    // wakes up stopAsyncWriter()
+    std::lock_guard<std::mutex> lock(_asyncMutex);
+    _asyncStopped = true;
+    _asyncFlushCondition.notify_all();
+}
+
+// writes a batch of records taken out of the async queue
+void Log::writeBatch (LogRecord *records, const size_t count)
+{
+    uint64_t flushTicket = 0;
+    
+    // lock every output only once per batch
+    std::unique_lock<std::mutex> coutLock(_cout_mutex, std::defer_lock);
+    std::unique_lock<std::mutex> cerrLock(_cerr_mutex, std::defer_lock);
+    std::unique_lock<std::mutex> sinksLock(_sinksMutex, std::defer_lock);
+    
+    bool hasSinks = _hasSinks.load(std::memory_order_acquire);
+    
+    for (size_t i = 0; i < count; i++) {
+        
+        LogRecord &record = records[i];
+        
+        if (hasSinks && (record.kind == LogRecordKindOutput ||
+                         record.kind == LogRecordKindError)) {
+            if (!sinksLock.owns_lock()) {
+                sinksLock.lock();
+                for (auto &sink : _sinks) {
+                    sink->beginBatch();
+                }
+            }
+            writeSinks(record);
+            continue;
+        }
+        
+        switch (record.kind) {
+            case LogRecordKindOutput:
+            case LogRecordKindOutputChunk:
+            case LogRecordKindBinary:
+            case LogRecordKindBinaryFormat: {
+                if (!coutLock.owns_lock()) {
+                    lockMeasured(coutLock, _outputContended, _outputWait);
+                    _logFile->beginBatch();
+                    _binaryFile->beginBatch();
+                }
+                writeOutput(record);
+            } break;
+                
+            case LogRecordKindError: {
+                if (!cerrLock.owns_lock()) {
+                    lockMeasured(cerrLock, _errorContended, _errorWait);
+                    _errorFile->beginBatch();
+                }
+                writeError(record);
+            } break;
+                
+            case LogRecordKindFlush: {
+                flushTicket = record.ticket;
+            } break;
+        }
+    }
+    
+    // group commit: every file is written (and synchronized) once per batch
+    if (coutLock.owns_lock()) {
+        _logFile->endBatch();
+        _binaryFile->endBatch();
+        coutLock.unlock();
+    }
+    if (cerrLock.owns_lock()) {
+        _errorFile->endBatch();
+        cerrLock.unlock();
+    }
+    if (sinksLock.owns_lock()) {
+        for (auto &sink : _sinks) {
+            sink->endBatch();
+        }
+        sinksLock.unlock();
+    }
+    
+    // everything before the flush record is written now
+    if (flushTicket > 0) {
+        std::lock_guard<std::mutex> lock(_asyncMutex);
+        _asyncFlushCompleted = flushTicket;
+        _asyncFlushCondition.notify_all();
+    }
+}
+
+// writes the timestamp in front of a line into the buffer, returns the length
+size_t Log::formatPrefix (const LogRecord &record, char *prefix) const
+{
+    if (record.structured) {
+        return 0;
+    }
+    
+    return LogTimestamp::format(prefix, record.timestamp,
+                                config()->timestampPrecision);
+}
+
+// formats a record once and writes it to all sinks that accept it
+// (_sinksMutex is locked)
+void Log::writeSinks (const LogRecord &record)
+{
+    char prefix[LogTimestamp::kMaxLength];
+    size_t length = formatPrefix(record, prefix);
+    
+    _sinkLine.clear();
+    _sinkLine.append(prefix, length);
+    _sinkLine.append(record.text);
+    _sinkLine.push_back('\n');
+    
+    LogSinkRecord sinkRecord;
+    sinkRecord.level = record.kind == LogRecordKindError ? LoglevelError
+                                                         : record.level;
+    sinkRecord.timestamp = record.timestamp;
+    sinkRecord.fgcolor = record.fgcolor;
+    sinkRecord.bgcolor = record.bgcolor;
+    sinkRecord.line = _sinkLine.data();
+    sinkRecord.lineSize = _sinkLine.size();
+    sinkRecord.message = _sinkLine.data() + length;
+    sinkRecord.messageSize = record.text.size();
+    
+    bool collect = _collectMetrics.load(std::memory_order_relaxed);
+    
+    for (size_t i = 0; i < _sinks.size(); i++) {
+        if (_sinks[i]->accepts(sinkRecord.level)) {
+            LogLatencyScope latency(collect ? _sinkLatencies[i].get() : nullptr);
+            _sinks[i]->write(sinkRecord);
+        }
+    }
+}
+
+// writes a record into the memory mapped logfile without locking
+bool Log::writeMapped (const LogRecord &record)
+{
+    static thread_local std::string line;
+    line.clear();
+    
+    char prefix[LogTimestamp::kMaxLength];
+    size_t length = formatPrefix(record, prefix);
+    
+    line.append(prefix, length);
+    line.append(record.text);
+    line.push_back('\n');
+    
+    return _mappedFile->write(line.data(), line.size());
+}
+
+// appends the formatted output line of a record to the string
+void Log::formatOutput (const LogRecord &record, std::string &line)
+{
+    if (_hasLogfile) {
+        
+        // logfiles get the time in front of each line
+        char prefix[LogTimestamp::kMaxLength];
+        size_t length = formatPrefix(record, prefix);
+        
+        line.append(prefix, length);
+        line.append(record.text);
+        line.push_back('\n');
+        
+    } else {
+        
+        // color, text and reset from the precomputed table
+        appendLogConsoleLine(line, record.text.data(), record.text.size(),
+                             record.fgcolor, record.bgcolor,
+                             config()->useAnsiSgrCodes);
+    }
+}
+
+// writes formatted lines to std::cout or the logfile (_cout_mutex is locked)
+void Log::writeFormattedOutput (const std::string &lines)
+{
+    // use log file if possible
+    if (_hasLogfile) {
+        _logFile->append(lines);
+        _logFile->endLine(false);
+    } else {
+        // output to stdout (the whole line with a single write)
+        writeLogConsole(false, lines.data(), lines.size());
+    }
+}
+
+// writes a record to std::cout or the logfile (_cout_mutex is locked)
+void Log::writeOutput (const LogRecord &record)
+{
+    LogLatencyScope latency(_collectMetrics.load(std::memory_order_relaxed)
+                            ? _outputLatency.get() : nullptr);
+    
+    if (record.kind == LogRecordKindOutputChunk) {
+        writeFormattedOutput(record.text);
+        return;
+    }
+    
+    if (record.kind == LogRecordKindBinary ||
+        record.kind == LogRecordKindBinaryFormat) {
+        // the binary logfile may have been closed in the meantime
+        if (_binaryFile->isOpen()) {
+            _binaryFile->append(record.text);
+            _binaryFile->endLine(false);
+        }
+        return;
+    }
+    
+    _outputLine.clear();
+    formatOutput(record, _outputLine);
+    writeFormattedOutput(_outputLine);
+}
+
+// formats a record into the buffer of the calling thread
+void Log::bufferOutput (const LogRecord &record, const size_t bufferSize)
+{
+    LogThreadBuffer *buffer = threadBufferHolder.buffer;
+    
+    // first use in this thread -> create and register the buffer
+    if (buffer == nullptr) {
+        buffer = new LogThreadBuffer();
+        buffer->data.reserve(bufferSize);
+        threadBufferHolder.buffer = buffer;
+        
+        std::lock_guard<std::mutex> lock(_threadBuffersMutex);
+        _threadBuffers.push_back(buffer);
+    }
+    
+    std::unique_lock<std::mutex> lock(buffer->mutex);
+    
+    if (buffer->data.empty()) {
+        buffer->since = std::chrono::steady_clock::now();
+    }
+    formatOutput(record, buffer->data);
+    
+    if (buffer->data.size() >= bufferSize) {
+        handOver(*buffer);
+    }
+}
+
+// hands the content of a per-thread buffer to the output
+// (the mutex of the buffer is locked)
+void Log::handOver (LogThreadBuffer &buffer)
+{
+    if (buffer.data.empty()) {
+        return;
+    }
+    
+    LogRecord record;
+    record.kind = LogRecordKindOutputChunk;
+    record.text.swap(buffer.data);
+    
+    dispatch(record);
+    
+    // keep the memory for the next lines (the writer thread hands back the
+    // memory of an earlier chunk)
+    buffer.data.swap(record.text);
+    buffer.data.clear();
+}
+
+// hands over all per-thread buffers (only old ones if onlyDue is set)
+void Log::handOverThreadBuffers (const bool onlyDue)
+{
+    std::chrono::milliseconds interval { 0 };
+    if (onlyDue) {
+        std::lock_guard<std::mutex> lock(_flushMutex);
+        interval = std::chrono::milliseconds(_threadBufferInterval);
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    
+    std::lock_guard<std::mutex> lock(_threadBuffersMutex);
+    
+    for (LogThreadBuffer *buffer : _threadBuffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        if (!onlyDue || now - buffer->since >= interval) {
+            handOver(*buffer);
+        }
+    }
+}
+
+// hands over and forgets the buffer of an exiting thread
+void Log::releaseThreadBuffer (LogThreadBuffer *buffer)
+{
+    {
+        std::lock_guard<std::mutex> lock(_threadBuffersMutex);
+        _threadBuffers.erase(std::find(_threadBuffers.begin(),
+                                       _threadBuffers.end(),
+                                       buffer));
+    }
+    
+    {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        handOver(*buffer);
+    }
+    
+    delete buffer;
+}
+
+// writes a record to std::cerr or the errorfile (_cerr_mutex is locked)
+void Log::writeError (const LogRecord &record)
+{
+    LogLatencyScope latency(_collectMetrics.load(std::memory_order_relaxed)
+                            ? _errorLatency.get() : nullptr);
+    
+    // use log file if possible
+    if (_hasErrorfile) {
+        
+        char prefix[LogTimestamp::kMaxLength];
+        size_t length = formatPrefix(record, prefix);
+        
+        _errorFile->append(prefix, length);
+        _errorFile->append(record.text);
+        _errorFile->append('\n');
+        _errorFile->endLine(true);
+        
+    } else {
+        
+        // output to stderr (the whole line with a single write)
+        _errorLine.clear();
+        _errorLine.append(record.text);
+        _errorLine.push_back('\n');
+        writeLogConsole(true, _errorLine.data(), _errorLine.size());
+    }
+}
+
+// main loop of the flush thread
+void Log::flushLoop ()
+{
+    std::unique_lock<std::mutex> lock(_flushMutex);
+    
+    auto lastMetricsDump = std::chrono::steady_clock::now();
+    auto lastSummaries = lastMetricsDump;
+    
+    while (!_flushStop) {
+        
+        // wake up for the shortest one of the intervals
+        unsigned int interval = 0;
+        for (unsigned int candidate : { _flushPolicy.interval,
+                                        _threadBufferInterval,
+                                        _metricsInterval,
+                                        _summaryInterval }) {
+            if (candidate > 0 && (interval == 0 || candidate < interval)) {
+                interval = candidate;
+            }
+        }
+        
+        _flushCondition.wait_for(lock, std::chrono::milliseconds(interval));
+        if (_flushStop) {
+            break;
+        }
+        
+        bool handOverBuffers = _threadBufferInterval > 0;
+        
+        // the metrics file is only written if its interval elapsed
+        std::string metricsPath;
+        auto now = std::chrono::steady_clock::now();
+        if (_metricsInterval > 0 &&
+            now - lastMetricsDump >= std::chrono::milliseconds(_metricsInterval)) {
+            metricsPath = _metricsPath;
+            lastMetricsDump = now;
+        }
+        
+        // a storm of dropped messages is summarized once per interval
+        bool writeSummaries = false;
+        if (_summaryInterval > 0 &&
+            now - lastSummaries >= std::chrono::milliseconds(_summaryInterval)) {
+            writeSummaries = true;
+            lastSummaries = now;
+        }
+        
+        // don't block setFlushPolicy() while waiting for the outputs
+        lock.unlock();
+        if (handOverBuffers) {
+            handOverThreadBuffers(true);
+        }
+        if (!metricsPath.empty()) {
+            dumpMetrics(metricsPath);
+        }
+        if (writeSummaries) {
+            writePendingSummaries();
+        }
+        {
+            std::lock_guard<std::mutex> coutLock(_cout_mutex);
+            _logFile->flushIfDue();
+            _binaryFile->flushIfDue();
+        }
+        {
+            std::lock_guard<std::mutex> cerrLock(_cerr_mutex);
+            _errorFile->flushIfDue();
+        }
+        {
+            std::lock_guard<std::mutex> sinksLock(_sinksMutex);
+            for (auto &sink : _sinks) {
+                sink->flushIfDue();
+            }
+        }
+        lock.lock();
+    }
+}
+
+// stops the flush thread (_flushMutex has to be locked)
+void Log::stopFlushThread (std::unique_lock<std::mutex> &lock)
+{
+    if (!_flushThread.joinable()) {
+        return;
+    }
+    
+    _flushStop = true;
+    _flushCondition.notify_one();
+    
+    lock.unlock();
+    _flushThread.join();
+    lock.lock();
+}
+
+// (re)starts the flush thread if it is needed (_flushMutex has to be locked)
+void Log::restartFlushThread (std::unique_lock<std::mutex> &lock)
+{
+    stopFlushThread(lock);
+    
+    if (_flushPolicy.interval > 0 || _threadBufferInterval > 0 ||
+        _metricsInterval > 0 || _summaryInterval > 0) {
+        _flushStop = false;
+        _flushThread = std::thread(&Log::flushLoop, this);
+    }
+}
+
+// writes buffered output of both logfiles
+void Log::flushFiles ()
+{
+    {
+        std::lock_guard<std::mutex> lock(_cout_mutex);
+        _logFile->flush();
+        _binaryFile->flush();
+    }
+    {
+        std::lock_guard<std::mutex> lock(_cerr_mutex);
+        _errorFile->flush();
+    }
+    {
+        std::lock_guard<std::mutex> lock(_sinksMutex);
+        for (auto &sink : _sinks) {
+            sink->flush();
+        }
+    }
 }
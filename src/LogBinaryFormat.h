@@ -0,0 +1,83 @@
+/*
+ RGPUtils
+ LogBinaryFormat.h
+
+ Layout of binary logfiles (written by Log::useBinaryLogfile() and read by
+ the rgplog-decode tool). All numbers are stored in the byte order of the
+ writing machine.
+
+   file     := { header | format | event }
+   header   := magic[8]                      (starts a new session, all
+                                              known formats are forgotten)
+   format   := 'F' id:u32 size:u32 char[size]
+   event    := 'E' id:u32 timestamp:i64 level:u8 flags:u8 count:u8
+               { argument }
+   argument := type:u8 value
+               (Int, UInt, Double, Pointer: 8 bytes;
+                Bool, Char: 1 byte; String: size:u32 char[size])
+
+ The timestamp is given in nanoseconds since the epoch.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogBinaryFormat_H__
+#define __RGPUtils__LogBinaryFormat_H__
+
+#include <rgp/LogFormat.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace rgp {
+
+    // magic bytes of a session header
+    static const char kLogBinaryMagic[8] = { 'R', 'G', 'P', 'L', 'O', 'G', 0, 1 };
+
+    // entry tags
+    static const char kLogBinaryFormatTag = 'F';
+    static const char kLogBinaryEventTag = 'E';
+
+    // event flags
+    static const uint8_t kLogBinaryFlagError = 0x01;
+
+    // appends a value in machine byte order
+    template <typename T>
+    inline void appendLogBinaryValue (std::string &output, const T value)
+    {
+        char bytes[sizeof(T)];
+        memcpy(bytes, &value, sizeof(T));
+        output.append(bytes, sizeof(T));
+    }
+
+    // appends a format entry
+    void encodeLogBinaryFormat (std::string &output, const uint32_t id,
+                                const std::string &format);
+
+    // appends an event entry
+    void encodeLogBinaryEvent (std::string &output, const uint32_t id,
+                               const int64_t timestamp, const uint8_t level,
+                               const uint8_t flags,
+                               const LogArgument *arguments,
+                               const size_t count);
+}
+
+#endif // defined(__RGPUtils__LogBinaryFormat_H__) header guard
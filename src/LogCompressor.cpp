@@ -0,0 +1,164 @@
+/*
+ RGPUtils
+ LogCompressor.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LogCompressor.h"
+
+#include <chrono>
+#include <cstdio>   // fopen / remove
+
+#if defined(RGPUTILS_HAS_ZLIB)
+#include <zlib.h>
+#endif // defined(RGPUTILS_HAS_ZLIB)
+
+using namespace rgp;
+
+LogCompressor::~LogCompressor ()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+bool LogCompressor::isAvailable ()
+{
+#if defined(RGPUTILS_HAS_ZLIB)
+    return true;
+#else
+    return false;
+#endif // defined(RGPUTILS_HAS_ZLIB)
+}
+
+void LogCompressor::compress (const std::string &path)
+{
+    if (!isAvailable()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _paths.push_back(path);
+
+    // the thread is only started when there is something to do
+    if (!_thread.joinable()) {
+        _thread = std::thread(&LogCompressor::run, this);
+    } else {
+        _condition.notify_all();
+    }
+}
+
+bool LogCompressor::wait (const unsigned int timeout)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto done = [this] { return _paths.empty() && !_busy; };
+    if (timeout == 0) {
+        _condition.wait(lock, done);
+        return true;
+    }
+    return _condition.wait_for(lock, std::chrono::milliseconds(timeout), done);
+}
+
+// main loop of the compression thread
+void LogCompressor::run ()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (;;) {
+
+        _condition.wait(lock, [this] { return _stop || !_paths.empty(); });
+
+        // finish the queued files even if we should stop
+        if (_paths.empty()) {
+            break;
+        }
+
+        std::string path = _paths.front();
+        _paths.pop_front();
+        _busy = true;
+
+        lock.unlock();
+        compressFile(path);
+        lock.lock();
+
+        // wakes up wait()
+        _busy = false;
+        _condition.notify_all();
+    }
+}
+
+// compresses a single file, returns false on error
+bool LogCompressor::compressFile (const std::string &path)
+{
+#if defined(RGPUTILS_HAS_ZLIB)
+    FILE *input = fopen(path.c_str(), "rb");
+    if (input == nullptr) {
+        return false;
+    }
+
+    std::string compressedPath = path + ".gz";
+    gzFile output = gzopen(compressedPath.c_str(), "wb6");
+    if (output == nullptr) {
+        fclose(input);
+        return false;
+    }
+
+    bool success = true;
+    char buffer[65536];
+    size_t length;
+
+    while ((length = fread(buffer, 1, sizeof(buffer), input)) > 0) {
+        if (gzwrite(output, buffer, (unsigned int)length) != (int)length) {
+            success = false;
+            break;
+        }
+    }
+
+    if (ferror(input)) {
+        success = false;
+    }
+
+    fclose(input);
+    if (gzclose(output) != Z_OK) {
+        success = false;
+    }
+
+    // keep the uncompressed file if something went wrong
+    if (success) {
+        remove(path.c_str());
+    } else {
+        remove(compressedPath.c_str());
+    }
+
+    return success;
+#else
+    (void)path;
+    return false;
+#endif // defined(RGPUTILS_HAS_ZLIB)
+}
@@ -0,0 +1,78 @@
+/*
+ RGPUtils
+ LogCompressor.h
+
+ Compresses rotated logfiles in a background thread, so the logging
+ threads never wait for the compression.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogCompressor_H__
+#define __RGPUtils__LogCompressor_H__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace rgp {
+
+    class LogCompressor {
+
+    public:
+        LogCompressor () {}
+
+        // compresses all files that are still queued
+        ~LogCompressor ();
+
+        LogCompressor (const LogCompressor &) = delete;
+        LogCompressor &operator = (const LogCompressor &) = delete;
+
+        // true if the library was built with zlib
+        static bool isAvailable ();
+
+        // queues a file, it will be replaced by "<path>.gz"
+        void compress (const std::string &path);
+
+        // waits until all queued files are compressed, at most timeout
+        // milliseconds (0 = forever), returns false if they weren't in time
+        bool wait (const unsigned int timeout);
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::deque<std::string> _paths;
+        std::thread _thread;
+        bool _stop { false };
+
+        // true while a file is compressed
+        bool _busy { false };
+
+        // main loop of the compression thread
+        void run ();
+
+        // compresses a single file, returns false on error
+        static bool compressFile (const std::string &path);
+    };
+}
+
+#endif // defined(__RGPUtils__LogCompressor_H__) header guard
@@ -0,0 +1,145 @@
+/*
+ RGPUtils
+ LogConfigSnapshot.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LogConfigSnapshot.h"
+
+#include <limits>
+#include <mutex>
+#include <vector>
+
+using namespace rgp;
+
+namespace rgp {
+
+    struct LogConfigReader {
+
+        // the epoch the thread started reading in (0 = not reading), only
+        // written by the owning thread
+        std::atomic<uint64_t> epoch { 0 };
+
+        // number of nested references of the owning thread
+        unsigned int depth { 0 };
+
+        // false if the thread quit and the reader can be reused
+        // (protected by readersMutex())
+        bool used { false };
+    };
+}
+
+// the readers of all threads, never freed so threads that quit after the
+// static destructors ran can still release their reader
+static std::mutex &readersMutex ()
+{
+    static std::mutex *mutex = new std::mutex();
+    return *mutex;
+}
+
+static std::vector<LogConfigReader *> &readers ()
+{
+    static std::vector<LogConfigReader *> *readers = new std::vector<LogConfigReader *>();
+    return *readers;
+}
+
+// takes the reader of the current thread, releases it on thread exit
+struct LogConfigReaderHolder {
+
+    LogConfigReader *reader { nullptr };
+
+    LogConfigReader *get ()
+    {
+        if (reader != nullptr) {
+            return reader;
+        }
+
+        std::lock_guard<std::mutex> lock(readersMutex());
+        for (LogConfigReader *unused : readers()) {
+            if (!unused->used) {
+                reader = unused;
+                break;
+            }
+        }
+        if (reader == nullptr) {
+            reader = new LogConfigReader();
+            readers().push_back(reader);
+        }
+        reader->used = true;
+
+        return reader;
+    }
+
+    ~LogConfigReaderHolder ()
+    {
+        if (reader != nullptr) {
+            std::lock_guard<std::mutex> lock(readersMutex());
+            reader->used = false;
+        }
+
+        // other thread exit handlers may still log
+        reader = nullptr;
+    }
+};
+
+static thread_local LogConfigReaderHolder readerHolder;
+
+LogConfigRef::LogConfigRef (const std::atomic<const LogConfigSnapshot *> &config,
+                            const std::atomic<uint64_t> &epoch)
+: _reader(readerHolder.get())
+{
+    // the outermost reference announces the epoch before the pointer is
+    // loaded: a snapshot replaced after that has a higher retired epoch
+    // (sequentially consistent, pairs with Log::publishConfig())
+    if (_reader->depth++ == 0) {
+        _reader->epoch.store(epoch.load());
+    }
+
+    _snapshot = config.load();
+}
+
+LogConfigRef::LogConfigRef (LogConfigRef &&other)
+: _snapshot(other._snapshot), _reader(other._reader)
+{
+    other._reader = nullptr;
+}
+
+LogConfigRef::~LogConfigRef ()
+{
+    if (_reader != nullptr && --_reader->depth == 0) {
+        _reader->epoch.store(0, std::memory_order_release);
+    }
+}
+
+uint64_t rgp::oldestLogConfigEpoch ()
+{
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+
+    std::lock_guard<std::mutex> lock(readersMutex());
+    for (LogConfigReader *reader : readers()) {
+        uint64_t epoch = reader->epoch.load();
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    return oldest;
+}
@@ -0,0 +1,116 @@
+/*
+ RGPUtils
+ LogConfigSnapshot.h
+
+ The configuration of the Log that is read while logging. A snapshot is
+ never changed after it was published: Log setters copy the current
+ snapshot, change the copy and swap the pointer (read-copy-update), so
+ logging threads read a consistent configuration without locking.
+
+ Replaced snapshots are freed with epochs: a thread that reads a snapshot
+ announces the epoch it started reading in, a snapshot that was replaced in
+ a later epoch than the oldest announced one can't be read anymore.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogConfigSnapshot_H__
+#define __RGPUtils__LogConfigSnapshot_H__
+
+#include <rgp/Log.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace rgp {
+
+    struct LogConfigSnapshot {
+
+        // precision of the time in front of each logfile line
+        LogTimestampPrecision timestampPrecision { LogTimestampPrecisionSeconds };
+
+        // encoding of structured records
+        LogStructuredFormat structuredFormat { LogStructuredFormatLogfmt };
+
+        // determines if ANSI SGR Codes should be used or not
+        bool useAnsiSgrCodes { false };
+
+        // the rate limit of the call sites as set
+        LogRateLimit rateLimit;
+
+        // the rate limit in nanoseconds: time per token (0 = disabled),
+        // tolerated burst and duplicate interval (0 = disabled)
+        int64_t rateInterval { 0 };
+        int64_t rateTolerance { 0 };
+        int64_t duplicateInterval { 0 };
+
+        // what happens if the async queue is full
+        LogOverflowPolicy overflowPolicy { LogOverflowPolicyBlock };
+        Loglevel overflowLevel { LoglevelWarning };
+
+        // the epoch the snapshot was replaced in (0 = still published)
+        uint64_t retiredEpoch { 0 };
+    };
+
+    // the reading state of a thread (reused after the thread quit)
+    struct LogConfigReader;
+
+    /**
+     @brief A snapshot that is read.
+     @details The snapshot isn't freed while the reference exists. References
+     of a thread may be nested, they must not be passed to other threads.
+     */
+    class LogConfigRef {
+
+    public:
+        // announces the current epoch and loads the current snapshot
+        LogConfigRef (const std::atomic<const LogConfigSnapshot *> &config,
+                      const std::atomic<uint64_t> &epoch);
+
+        LogConfigRef (LogConfigRef &&other);
+
+        ~LogConfigRef ();
+
+        LogConfigRef (const LogConfigRef &) = delete;
+        LogConfigRef &operator = (const LogConfigRef &) = delete;
+
+        const LogConfigSnapshot *operator -> () const
+        {
+            return _snapshot;
+        }
+
+        const LogConfigSnapshot &operator * () const
+        {
+            return *_snapshot;
+        }
+
+    private:
+        const LogConfigSnapshot *_snapshot;
+
+        // null if moved from
+        LogConfigReader *_reader;
+    };
+
+    // the oldest epoch a thread started reading in, UINT64_MAX if no thread
+    // reads (a snapshot replaced in this epoch or earlier can be freed)
+    uint64_t oldestLogConfigEpoch ();
+}
+
+#endif // defined(__RGPUtils__LogConfigSnapshot_H__) header guard
@@ -0,0 +1,283 @@
+/*
+ RGPUtils
+ LogConsole.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LogConsole.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>   // fileno
+#include <iostream> // cout / cerr
+#include <mutex>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif // defined(_WIN32)
+
+using namespace rgp;
+
+// the escape sequence as string literal and its length
+#define RGP_SGR(fg, bg) { "\033[" #fg ";" #bg "m", sizeof("\033[" #fg ";" #bg "m") - 1 }
+#define RGP_SGR_NONE { "", 0 }
+
+// rows are foreground colors, columns background colors (index 8 is unused,
+// 38 / 48 introduce extended colors)
+const LogSgrCode rgp::kLogSgrCodes[18][18] = {
+    {
+        RGP_SGR(30, 40), RGP_SGR(30, 41), RGP_SGR(30, 42), RGP_SGR(30, 43),
+        RGP_SGR(30, 44), RGP_SGR(30, 45), RGP_SGR(30, 46), RGP_SGR(30, 47),
+        RGP_SGR_NONE, RGP_SGR(30, 49), RGP_SGR(30, 100), RGP_SGR(30, 101),
+        RGP_SGR(30, 102), RGP_SGR(30, 103), RGP_SGR(30, 104), RGP_SGR(30, 105),
+        RGP_SGR(30, 106), RGP_SGR(30, 107)
+    },
+    {
+        RGP_SGR(31, 40), RGP_SGR(31, 41), RGP_SGR(31, 42), RGP_SGR(31, 43),
+        RGP_SGR(31, 44), RGP_SGR(31, 45), RGP_SGR(31, 46), RGP_SGR(31, 47),
+        RGP_SGR_NONE, RGP_SGR(31, 49), RGP_SGR(31, 100), RGP_SGR(31, 101),
+        RGP_SGR(31, 102), RGP_SGR(31, 103), RGP_SGR(31, 104), RGP_SGR(31, 105),
+        RGP_SGR(31, 106), RGP_SGR(31, 107)
+    },
+    {
+        RGP_SGR(32, 40), RGP_SGR(32, 41), RGP_SGR(32, 42), RGP_SGR(32, 43),
+        RGP_SGR(32, 44), RGP_SGR(32, 45), RGP_SGR(32, 46), RGP_SGR(32, 47),
+        RGP_SGR_NONE, RGP_SGR(32, 49), RGP_SGR(32, 100), RGP_SGR(32, 101),
+        RGP_SGR(32, 102), RGP_SGR(32, 103), RGP_SGR(32, 104), RGP_SGR(32, 105),
+        RGP_SGR(32, 106), RGP_SGR(32, 107)
+    },
+    {
+        RGP_SGR(33, 40), RGP_SGR(33, 41), RGP_SGR(33, 42), RGP_SGR(33, 43),
+        RGP_SGR(33, 44), RGP_SGR(33, 45), RGP_SGR(33, 46), RGP_SGR(33, 47),
+        RGP_SGR_NONE, RGP_SGR(33, 49), RGP_SGR(33, 100), RGP_SGR(33, 101),
+        RGP_SGR(33, 102), RGP_SGR(33, 103), RGP_SGR(33, 104), RGP_SGR(33, 105),
+        RGP_SGR(33, 106), RGP_SGR(33, 107)
+    },
+    {
+        RGP_SGR(34, 40), RGP_SGR(34, 41), RGP_SGR(34, 42), RGP_SGR(34, 43),
+        RGP_SGR(34, 44), RGP_SGR(34, 45), RGP_SGR(34, 46), RGP_SGR(34, 47),
+        RGP_SGR_NONE, RGP_SGR(34, 49), RGP_SGR(34, 100), RGP_SGR(34, 101),
+        RGP_SGR(34, 102), RGP_SGR(34, 103), RGP_SGR(34, 104), RGP_SGR(34, 105),
+        RGP_SGR(34, 106), RGP_SGR(34, 107)
+    },
+    {
+        RGP_SGR(35, 40), RGP_SGR(35, 41), RGP_SGR(35, 42), RGP_SGR(35, 43),
+        RGP_SGR(35, 44), RGP_SGR(35, 45), RGP_SGR(35, 46), RGP_SGR(35, 47),
+        RGP_SGR_NONE, RGP_SGR(35, 49), RGP_SGR(35, 100), RGP_SGR(35, 101),
+        RGP_SGR(35, 102), RGP_SGR(35, 103), RGP_SGR(35, 104), RGP_SGR(35, 105),
+        RGP_SGR(35, 106), RGP_SGR(35, 107)
+    },
+    {
+        RGP_SGR(36, 40), RGP_SGR(36, 41), RGP_SGR(36, 42), RGP_SGR(36, 43),
+        RGP_SGR(36, 44), RGP_SGR(36, 45), RGP_SGR(36, 46), RGP_SGR(36, 47),
+        RGP_SGR_NONE, RGP_SGR(36, 49), RGP_SGR(36, 100), RGP_SGR(36, 101),
+        RGP_SGR(36, 102), RGP_SGR(36, 103), RGP_SGR(36, 104), RGP_SGR(36, 105),
+        RGP_SGR(36, 106), RGP_SGR(36, 107)
+    },
+    {
+        RGP_SGR(37, 40), RGP_SGR(37, 41), RGP_SGR(37, 42), RGP_SGR(37, 43),
+        RGP_SGR(37, 44), RGP_SGR(37, 45), RGP_SGR(37, 46), RGP_SGR(37, 47),
+        RGP_SGR_NONE, RGP_SGR(37, 49), RGP_SGR(37, 100), RGP_SGR(37, 101),
+        RGP_SGR(37, 102), RGP_SGR(37, 103), RGP_SGR(37, 104), RGP_SGR(37, 105),
+        RGP_SGR(37, 106), RGP_SGR(37, 107)
+    },
+    {
+        RGP_SGR_NONE, RGP_SGR_NONE, RGP_SGR_NONE, RGP_SGR_NONE,
+        RGP_SGR_NONE, RGP_SGR_NONE, RGP_SGR_NONE, RGP_SGR_NONE,
+        RGP_SGR_NONE, RGP_SGR_NONE, RGP_SGR_NONE, RGP_SGR_NONE,
+        RGP_SGR_NONE, RGP_SGR_NONE, RGP_SGR_NONE, RGP_SGR_NONE,
+        RGP_SGR_NONE, RGP_SGR_NONE
+    },
+    {
+        RGP_SGR(39, 40), RGP_SGR(39, 41), RGP_SGR(39, 42), RGP_SGR(39, 43),
+        RGP_SGR(39, 44), RGP_SGR(39, 45), RGP_SGR(39, 46), RGP_SGR(39, 47),
+        RGP_SGR_NONE, RGP_SGR_NONE, RGP_SGR(39, 100), RGP_SGR(39, 101),
+        RGP_SGR(39, 102), RGP_SGR(39, 103), RGP_SGR(39, 104), RGP_SGR(39, 105),
+        RGP_SGR(39, 106), RGP_SGR(39, 107)
+    },
+    {
+        RGP_SGR(90, 40), RGP_SGR(90, 41), RGP_SGR(90, 42), RGP_SGR(90, 43),
+        RGP_SGR(90, 44), RGP_SGR(90, 45), RGP_SGR(90, 46), RGP_SGR(90, 47),
+        RGP_SGR_NONE, RGP_SGR(90, 49), RGP_SGR(90, 100), RGP_SGR(90, 101),
+        RGP_SGR(90, 102), RGP_SGR(90, 103), RGP_SGR(90, 104), RGP_SGR(90, 105),
+        RGP_SGR(90, 106), RGP_SGR(90, 107)
+    },
+    {
+        RGP_SGR(91, 40), RGP_SGR(91, 41), RGP_SGR(91, 42), RGP_SGR(91, 43),
+        RGP_SGR(91, 44), RGP_SGR(91, 45), RGP_SGR(91, 46), RGP_SGR(91, 47),
+        RGP_SGR_NONE, RGP_SGR(91, 49), RGP_SGR(91, 100), RGP_SGR(91, 101),
+        RGP_SGR(91, 102), RGP_SGR(91, 103), RGP_SGR(91, 104), RGP_SGR(91, 105),
+        RGP_SGR(91, 106), RGP_SGR(91, 107)
+    },
+    {
+        RGP_SGR(92, 40), RGP_SGR(92, 41), RGP_SGR(92, 42), RGP_SGR(92, 43),
+        RGP_SGR(92, 44), RGP_SGR(92, 45), RGP_SGR(92, 46), RGP_SGR(92, 47),
+        RGP_SGR_NONE, RGP_SGR(92, 49), RGP_SGR(92, 100), RGP_SGR(92, 101),
+        RGP_SGR(92, 102), RGP_SGR(92, 103), RGP_SGR(92, 104), RGP_SGR(92, 105),
+        RGP_SGR(92, 106), RGP_SGR(92, 107)
+    },
+    {
+        RGP_SGR(93, 40), RGP_SGR(93, 41), RGP_SGR(93, 42), RGP_SGR(93, 43),
+        RGP_SGR(93, 44), RGP_SGR(93, 45), RGP_SGR(93, 46), RGP_SGR(93, 47),
+        RGP_SGR_NONE, RGP_SGR(93, 49), RGP_SGR(93, 100), RGP_SGR(93, 101),
+        RGP_SGR(93, 102), RGP_SGR(93, 103), RGP_SGR(93, 104), RGP_SGR(93, 105),
+        RGP_SGR(93, 106), RGP_SGR(93, 107)
+    },
+    {
+        RGP_SGR(94, 40), RGP_SGR(94, 41), RGP_SGR(94, 42), RGP_SGR(94, 43),
+        RGP_SGR(94, 44), RGP_SGR(94, 45), RGP_SGR(94, 46), RGP_SGR(94, 47),
+        RGP_SGR_NONE, RGP_SGR(94, 49), RGP_SGR(94, 100), RGP_SGR(94, 101),
+        RGP_SGR(94, 102), RGP_SGR(94, 103), RGP_SGR(94, 104), RGP_SGR(94, 105),
+        RGP_SGR(94, 106), RGP_SGR(94, 107)
+    },
+    {
+        RGP_SGR(95, 40), RGP_SGR(95, 41), RGP_SGR(95, 42), RGP_SGR(95, 43),
+        RGP_SGR(95, 44), RGP_SGR(95, 45), RGP_SGR(95, 46), RGP_SGR(95, 47),
+        RGP_SGR_NONE, RGP_SGR(95, 49), RGP_SGR(95, 100), RGP_SGR(95, 101),
+        RGP_SGR(95, 102), RGP_SGR(95, 103), RGP_SGR(95, 104), RGP_SGR(95, 105),
+        RGP_SGR(95, 106), RGP_SGR(95, 107)
+    },
+    {
+        RGP_SGR(96, 40), RGP_SGR(96, 41), RGP_SGR(96, 42), RGP_SGR(96, 43),
+        RGP_SGR(96, 44), RGP_SGR(96, 45), RGP_SGR(96, 46), RGP_SGR(96, 47),
+        RGP_SGR_NONE, RGP_SGR(96, 49), RGP_SGR(96, 100), RGP_SGR(96, 101),
+        RGP_SGR(96, 102), RGP_SGR(96, 103), RGP_SGR(96, 104), RGP_SGR(96, 105),
+        RGP_SGR(96, 106), RGP_SGR(96, 107)
+    },
+    {
+        RGP_SGR(97, 40), RGP_SGR(97, 41), RGP_SGR(97, 42), RGP_SGR(97, 43),
+        RGP_SGR(97, 44), RGP_SGR(97, 45), RGP_SGR(97, 46), RGP_SGR(97, 47),
+        RGP_SGR_NONE, RGP_SGR(97, 49), RGP_SGR(97, 100), RGP_SGR(97, 101),
+        RGP_SGR(97, 102), RGP_SGR(97, 103), RGP_SGR(97, 104), RGP_SGR(97, 105),
+        RGP_SGR(97, 106), RGP_SGR(97, 107)
+    }
+};
+
+#undef RGP_SGR
+#undef RGP_SGR_NONE
+
+const LogSgrCode rgp::kLogSgrReset = { "\033[0m", 4 };
+
+void rgp::appendLogConsoleLine (std::string &line, const char *text,
+                                const size_t size, const AnsiSgrFgColor fgcolor,
+                                const AnsiSgrBgColor bgcolor, const bool colored)
+{
+    const LogSgrCode &code = logSgrCode(fgcolor, bgcolor);
+
+    if (colored && code.length > 0) {
+        line.append(code.text, code.length);
+        line.append(text, size);
+        line.append(kLogSgrReset.text, kLogSgrReset.length);
+    } else {
+        line.append(text, size);
+    }
+
+    line.push_back('\n');
+}
+
+bool rgp::isLogConsoleTerminal (const bool error)
+{
+#if defined(_WIN32)
+    return _isatty(_fileno(error ? stderr : stdout)) != 0;
+#else
+    return isatty(fileno(error ? stderr : stdout)) != 0;
+#endif // defined(_WIN32)
+}
+
+// output to stdout that is collected while the console is held
+static std::atomic<bool> consoleHeld { false };
+static std::mutex heldOutputMutex;
+static std::string heldOutput;
+
+// a prompt may wait for hours, more output than this is written anyway
+static const size_t kMaxHeldOutput = 4 * 1024 * 1024;
+
+static void writeConsole (const bool error, const char *data, const size_t size)
+{
+    std::ostream &stream = error ? std::cerr : std::cout;
+
+#if defined(_WIN32)
+    stream.write(data, size);
+    stream.flush();
+#else
+    // keep the order with output that was written through the stream
+    stream.flush();
+
+    int fd = fileno(error ? stderr : stdout);
+    size_t remaining = size;
+
+    while (remaining > 0) {
+        ssize_t written = ::write(fd, data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        remaining -= (size_t)written;
+    }
+#endif // defined(_WIN32)
+}
+
+void rgp::writeLogConsole (const bool error, const char *data, const size_t size)
+{
+    if (!error && consoleHeld.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(heldOutputMutex);
+
+        // the console may have been released in the meantime
+        if (consoleHeld.load(std::memory_order_relaxed)) {
+            if (heldOutput.size() + size <= kMaxHeldOutput) {
+                heldOutput.append(data, size);
+                return;
+            }
+
+            // too much output, keep the order and write it below the prompt
+            writeConsole(false, heldOutput.data(), heldOutput.size());
+            heldOutput.clear();
+            writeConsole(false, data, size);
+            return;
+        }
+    }
+
+    writeConsole(error, data, size);
+}
+
+void rgp::holdLogConsole ()
+{
+    std::lock_guard<std::mutex> lock(heldOutputMutex);
+    consoleHeld.store(true, std::memory_order_release);
+}
+
+void rgp::releaseLogConsole ()
+{
+    std::lock_guard<std::mutex> lock(heldOutputMutex);
+    consoleHeld.store(false, std::memory_order_release);
+
+    if (!heldOutput.empty()) {
+        writeConsole(false, heldOutput.data(), heldOutput.size());
+    }
+
+    // don't keep the memory until the next prompt
+    std::string().swap(heldOutput);
+}
@@ -0,0 +1,93 @@
+/*
+ RGPUtils
+ LogConsole.h
+
+ Console output of the Log class: a precomputed table with the ANSI SGR
+ escape sequences of all color combinations, terminal detection and writing
+ a complete line with a single system call.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogConsole_H__
+#define __RGPUtils__LogConsole_H__
+
+#include <rgp/Log.h>
+
+#include <cstddef>
+#include <string>
+
+namespace rgp {
+
+    // an escape sequence of the table
+    struct LogSgrCode {
+        const char *text;
+        size_t length;
+    };
+
+    // the sequences of all color combinations, indexed by logSgrIndex()
+    // (empty for the default colors)
+    extern const LogSgrCode kLogSgrCodes[18][18];
+
+    // resets the colors
+    extern const LogSgrCode kLogSgrReset;
+
+    // 30-37 / 40-47 -> 0-7, 90-97 / 100-107 -> 10-17, the defaults 39 / 49
+    // and all values cast to the color enums that aren't colors -> 9
+    inline size_t logSgrIndex (const unsigned int color)
+    {
+        if ((color >= 30 && color <= 37) || (color >= 40 && color <= 47)) {
+            return color % 10;
+        }
+        if ((color >= 90 && color <= 97) || (color >= 100 && color <= 107)) {
+            return color % 10 + 10;
+        }
+        return 9;
+    }
+
+    inline const LogSgrCode &logSgrCode (const AnsiSgrFgColor fgcolor,
+                                         const AnsiSgrBgColor bgcolor)
+    {
+        return kLogSgrCodes[logSgrIndex(fgcolor)][logSgrIndex(bgcolor)];
+    }
+
+    // appends color, text, reset and newline (colors only if colored is set
+    // and a color is not the default)
+    void appendLogConsoleLine (std::string &line, const char *text,
+                               const size_t size, const AnsiSgrFgColor fgcolor,
+                               const AnsiSgrBgColor bgcolor, const bool colored);
+
+    // true if stdout (or stderr) is a terminal
+    bool isLogConsoleTerminal (const bool error);
+
+    // writes the data to stdout (or stderr) with a single write if possible,
+    // output buffered in std::cout / std::cerr is written before
+    void writeLogConsole (const bool error, const char *data, const size_t size);
+
+    // while the console is held (f.e. during an input prompt) output to
+    // stdout is collected instead of written, output to stderr is still
+    // written
+    void holdLogConsole ();
+
+    // writes the collected output and stops holding the console
+    void releaseLogConsole ();
+}
+
+#endif // defined(__RGPUtils__LogConsole_H__) header guard
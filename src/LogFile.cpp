@@ -0,0 +1,367 @@
+/*
+ RGPUtils
+ LogFile.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LogFile.h"
+#include "LogCompressor.h"
+#include "LogConsole.h"
+
+#include <cerrno>
+#include <cstdio>   // rename / snprintf
+#include <cstring>  // strerror
+#include <ctime>    // names of rotated files
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif // defined(_WIN32)
+
+// small wrappers around the low level file functions of the platforms
+#if defined(_WIN32)
+static int openFile (const char *path)
+{
+    return _open(path, _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY,
+                 _S_IREAD | _S_IWRITE);
+}
+
+static long writeFile (const int fd, const char *data, const size_t size)
+{
+    return _write(fd, data, (unsigned int)size);
+}
+
+static void closeFile (const int fd)
+{
+    _close(fd);
+}
+
+static void syncFile (const int fd)
+{
+    _commit(fd);
+}
+
+static uint64_t fileSize (const int fd)
+{
+    struct _stat64 info;
+    return _fstat64(fd, &info) == 0 ? (uint64_t)info.st_size : 0;
+}
+
+static bool fileExists (const char *path)
+{
+    struct _stat64 info;
+    return _stat64(path, &info) == 0;
+}
+#else
+static int openFile (const char *path)
+{
+    return ::open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+}
+
+static long writeFile (const int fd, const char *data, const size_t size)
+{
+    return ::write(fd, data, size);
+}
+
+static void closeFile (const int fd)
+{
+    ::close(fd);
+}
+
+static void syncFile (const int fd)
+{
+#if defined(__APPLE__)
+    fsync(fd);
+#else
+    fdatasync(fd);
+#endif // defined(__APPLE__)
+}
+
+static uint64_t fileSize (const int fd)
+{
+    struct stat info;
+    return fstat(fd, &info) == 0 ? (uint64_t)info.st_size : 0;
+}
+
+static bool fileExists (const char *path)
+{
+    struct stat info;
+    return stat(path, &info) == 0;
+}
+#endif // defined(_WIN32)
+
+using namespace rgp;
+
+// the logfile can't report its own errors, they go to stderr
+static void reportError (const std::string &message)
+{
+    std::string line = "RGPUtils: " + message + "\n";
+    writeLogConsole(true, line.data(), line.size());
+}
+
+LogFile::~LogFile ()
+{
+    close();
+}
+
+bool LogFile::open (const std::string &path)
+{
+    close();
+    _reopenPending = false;
+
+    int fd = openFile(path.c_str());
+    if (fd < 0) {
+        return false;
+    }
+
+    _fd = fd;
+    _path = path;
+    _buffer.reserve(_policy.bufferSize > 0 ? _policy.bufferSize : 1024);
+    _lastFlush = std::chrono::steady_clock::now();
+    _size = fileSize(fd);
+    scheduleRotation();
+
+    return true;
+}
+
+void LogFile::close ()
+{
+    if (_fd < 0) {
+        return;
+    }
+
+    flush();
+    closeFile(_fd);
+    _fd = -1;
+}
+
+void LogFile::setFlushPolicy (const LogFlushPolicy &policy)
+{
+    _policy = policy;
+
+    // write what was buffered with the old policy
+    flush();
+}
+
+void LogFile::setRotationPolicy (const LogRotationPolicy &policy,
+                                 LogCompressor *compressor)
+{
+    _rotation = policy;
+    _compressor = compressor;
+
+    scheduleRotation();
+}
+
+void LogFile::append (const char *data, const size_t size)
+{
+    _buffer.append(data, size);
+}
+
+void LogFile::endLine (const bool isError)
+{
+    if (isError) {
+        _bufferHasError = true;
+    }
+
+    bool due = _buffer.size() >= _policy.bufferSize ||
+               (isError && _policy.flushOnError);
+
+    // the batch is written as a whole by endBatch()
+    if (_batching) {
+        _flushPending = _flushPending || due;
+        return;
+    }
+
+    if (due) {
+        flush();
+        rotateIfDue();
+    } else {
+        flushIfDue();
+    }
+}
+
+void LogFile::beginBatch ()
+{
+    _batching = true;
+}
+
+void LogFile::endBatch ()
+{
+    _batching = false;
+
+    if (_flushPending) {
+        _flushPending = false;
+        flush();
+        rotateIfDue();
+    } else {
+        flushIfDue();
+    }
+}
+
+void LogFile::flush ()
+{
+    if (_reopenPending) {
+        reopen();
+    }
+
+    if (_reopenPending) {
+        _lostBytes += _buffer.size();
+    }
+
+    if (_fd >= 0 && !_buffer.empty()) {
+
+        _flushes.fetch_add(1, std::memory_order_relaxed);
+
+        const char *data = _buffer.data();
+        size_t remaining = _buffer.size();
+
+        // write may write less than requested
+        while (remaining > 0) {
+            long written = writeFile(_fd, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // nothing we can do about it (we can't log the error)
+                break;
+            }
+            data += written;
+            remaining -= written;
+            _size += written;
+        }
+
+        // once per write of the buffer, not per line
+        if (_policy.sync == LogSyncPolicyAlways ||
+            (_policy.sync == LogSyncPolicyError && _bufferHasError)) {
+            syncFile(_fd);
+        }
+    }
+
+    _buffer.clear();
+    _bufferHasError = false;
+    _lastFlush = std::chrono::steady_clock::now();
+}
+
+void LogFile::flushIfDue ()
+{
+    if (_policy.interval > 0 && !_buffer.empty()) {
+        auto elapsed = std::chrono::steady_clock::now() - _lastFlush;
+        if (elapsed >= std::chrono::milliseconds(_policy.interval)) {
+            flush();
+        }
+    }
+
+    rotateIfDue();
+}
+
+// rotates the file if the rotation policy says so
+void LogFile::rotateIfDue ()
+{
+    // never rotate empty files
+    if (_fd < 0 || _size == 0) {
+        return;
+    }
+
+    if ((_rotation.maxSize > 0 && _size >= _rotation.maxSize) ||
+        (_rotation.interval > 0 && (int64_t)time(NULL) >= _nextRotation)) {
+        rotate();
+    }
+}
+
+// renames the current file and starts a new one
+void LogFile::rotate ()
+{
+    // the buffer belongs to the old file
+    flush();
+    closeFile(_fd);
+    _fd = -1;
+
+    // <path>.<date>-<time>[.<n>]
+    time_t now = time(NULL);
+    tm current_time;
+#if defined(_WIN32)
+    localtime_s(&current_time, &now);
+#else
+    localtime_r(&now, &current_time);
+#endif // defined(_WIN32)
+
+    // large enough for any value of the int fields
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%04d%02d%02d-%02d%02d%02d",
+             current_time.tm_year + 1900, current_time.tm_mon + 1,
+             current_time.tm_mday, current_time.tm_hour,
+             current_time.tm_min, current_time.tm_sec);
+
+    std::string rotatedPath = _path + suffix;
+    for (int i = 1; fileExists(rotatedPath.c_str()) ||
+                    fileExists((rotatedPath + ".gz").c_str()); i++) {
+        rotatedPath = _path + suffix + "." + std::to_string(i);
+    }
+
+    bool renamed = ::rename(_path.c_str(), rotatedPath.c_str()) == 0;
+
+    // continue with a new file (or the old one if renaming failed)
+    std::string path = _path;
+    if (!open(path)) {
+        reportError("can't open the logfile " + path + " after rotating it: " +
+                    strerror(errno));
+        _reopenPending = true;
+        _lastReopen = std::chrono::steady_clock::now();
+        _lostBytes = 0;
+    }
+
+    if (renamed && _rotation.compress && _compressor != nullptr) {
+        _compressor->compress(rotatedPath);
+    }
+}
+
+// calculates _nextRotation from now
+void LogFile::scheduleRotation ()
+{
+    if (_rotation.interval == 0) {
+        _nextRotation = 0;
+        return;
+    }
+
+    int64_t now = (int64_t)time(NULL);
+    _nextRotation = (now / _rotation.interval + 1) * _rotation.interval;
+}
+
+// tries to open the file again after a failed rotation
+void LogFile::reopen ()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - _lastReopen < std::chrono::seconds(1)) {
+        return;
+    }
+    _lastReopen = now;
+
+    // open() resets _reopenPending on success
+    uint64_t lostBytes = _lostBytes;
+    std::string path = _path;
+    if (open(path)) {
+        reportError("the logfile " + path + " is written again, " +
+                    std::to_string(lostBytes) + " bytes were lost");
+    }
+}
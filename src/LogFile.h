@@ -0,0 +1,151 @@
+/*
+ RGPUtils
+ LogFile.h
+
+ A logfile that stays open while it is used by the Log class. Output is
+ collected in a buffer and written according to a LogFlushPolicy.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogFile_H__
+#define __RGPUtils__LogFile_H__
+
+#include <rgp/Log.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace rgp {
+
+    class LogCompressor;
+
+    /**
+     @brief A buffered logfile.
+     @details Not thread-safe, the Log class protects every file with the
+     mutex of its output.
+     */
+    class LogFile {
+
+    public:
+        LogFile () {}
+        ~LogFile ();
+
+        LogFile (const LogFile &) = delete;
+        LogFile &operator = (const LogFile &) = delete;
+
+        // opens the file for appending (closes a previously opened file)
+        bool open (const std::string &path);
+
+        // writes the buffer and closes the file
+        void close ();
+
+        bool isOpen () const {
+            return _fd >= 0;
+        };
+
+        const std::string &path () const {
+            return _path;
+        };
+
+        void setFlushPolicy (const LogFlushPolicy &policy);
+
+        // rotated files are handed to the compressor if the policy says so
+        void setRotationPolicy (const LogRotationPolicy &policy,
+                                LogCompressor *compressor);
+
+        // appends data to the buffer
+        void append (const char *data, const size_t size);
+        void append (const std::string &text) {
+            append(text.data(), text.size());
+        };
+        void append (const char c) {
+            append(&c, 1);
+        };
+
+        // has to be called after a complete line was appended, flushes the
+        // buffer if the policy says so (at the end of a batch if one is open)
+        void endLine (const bool isError);
+
+        // collects the lines until endBatch() and writes them together
+        void beginBatch ();
+        void endBatch ();
+
+        // writes the buffer to the file
+        void flush ();
+
+        // flushes the buffer if the flush interval elapsed
+        void flushIfDue ();
+
+        // number of times the buffer was written to the file (may be read
+        // without the mutex of the output)
+        uint64_t flushCount () const {
+            return _flushes.load(std::memory_order_relaxed);
+        };
+
+    private:
+        int _fd { -1 };
+        std::string _path;
+        std::string _buffer;
+        LogFlushPolicy _policy;
+        std::chrono::steady_clock::time_point _lastFlush;
+        std::atomic<uint64_t> _flushes { 0 };
+
+        // true between beginBatch() and endBatch()
+        bool _batching { false };
+
+        // a line of the batch asked for a flush
+        bool _flushPending { false };
+
+        // the buffer contains an error (for LogSyncPolicyError)
+        bool _bufferHasError { false };
+
+        LogRotationPolicy _rotation;
+        LogCompressor *_compressor { nullptr };
+
+        // bytes in the current file
+        uint64_t _size { 0 };
+
+        // time (seconds since the epoch) of the next time based rotation
+        int64_t _nextRotation { 0 };
+
+        // the file couldn't be opened again after a rotation: opening is
+        // retried when the buffer is written (at most once per second),
+        // lines written in the meantime are lost
+        bool _reopenPending { false };
+        std::chrono::steady_clock::time_point _lastReopen;
+        uint64_t _lostBytes { 0 };
+
+        // rotates the file if the rotation policy says so
+        void rotateIfDue ();
+
+        // renames the current file and starts a new one
+        void rotate ();
+
+        // calculates _nextRotation from now
+        void scheduleRotation ();
+
+        // tries to open the file again after a failed rotation
+        void reopen ();
+    };
+}
+
+#endif // defined(__RGPUtils__LogFile_H__) header guard
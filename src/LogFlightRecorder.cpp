@@ -0,0 +1,428 @@
+/*
+ RGPUtils
+ LogFlightRecorder.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LogFlightRecorder.h"
+
+#include <algorithm> // std::min
+#include <cerrno>    // EINTR
+#include <csignal>   // raise
+#include <cstring>   // memcpy
+#include <memory>
+#include <thread>    // yield
+
+#include <fcntl.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif // defined(_WIN32)
+
+using namespace rgp;
+
+namespace rgp {
+
+    struct LogFlightRecorder::Ring {
+
+        // next buffer in the list (never changes after the buffer is added)
+        Ring *next { nullptr };
+
+        // true while a thread owns the buffer
+        std::atomic<bool> inUse { true };
+
+        // true while the owner writes or dump() reads the buffer
+        std::atomic<bool> busy { false };
+
+        // number of the thread in the dumps
+        uint64_t thread { 0 };
+
+        std::unique_ptr<char[]> data;
+        size_t size { 0 };
+
+        // bytes ever written (the position is written % size)
+        size_t written { 0 };
+    };
+}
+
+// owns the buffer of the current thread, releases it on thread exit
+struct LogFlightRingHolder {
+
+    LogFlightRecorder::Ring *ring { nullptr };
+
+    ~LogFlightRingHolder () {
+        if (ring != nullptr) {
+            LogFlightRecorder::releaseRing(ring);
+        }
+    }
+};
+
+static thread_local LogFlightRingHolder flightRingHolder;
+
+// writes everything, retries after interruptions (async-signal-safe)
+static void writeAll (const int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+#if defined(_WIN32)
+        int written = _write(fd, data, (unsigned int)size);
+#else
+        ssize_t written = ::write(fd, data, size);
+#endif // defined(_WIN32)
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+// appends a number to a buffer without the standard library
+// (async-signal-safe), returns the new length
+static size_t appendNumber (char *buffer, size_t length, uint64_t number)
+{
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + number % 10);
+        number /= 10;
+    } while (number > 0);
+
+    while (count > 0) {
+        buffer[length++] = digits[--count];
+    }
+    return length;
+}
+
+// copies data into the buffer, only the end is kept if it doesn't fit
+static void appendRing (LogFlightRecorder::Ring &ring, const char *data,
+                        size_t size)
+{
+    if (size >= ring.size) {
+        ring.written += size - ring.size;
+        data += size - ring.size;
+        size = ring.size;
+    }
+
+    size_t position = ring.written % ring.size;
+    size_t first = std::min(size, ring.size - position);
+
+    memcpy(ring.data.get() + position, data, first);
+    memcpy(ring.data.get(), data + first, size - first);
+    ring.written += size;
+}
+
+LogFlightRecorder::~LogFlightRecorder ()
+{
+    setDumpOnSignal(false);
+
+    int fd = _fd.exchange(-1);
+    if (fd >= 0) {
+#if defined(_WIN32)
+        _close(fd);
+#else
+        ::close(fd);
+#endif // defined(_WIN32)
+    }
+
+    Ring *ring = _rings.exchange(nullptr);
+    while (ring != nullptr) {
+        Ring *next = ring->next;
+        delete ring;
+        ring = next;
+    }
+}
+
+void LogFlightRecorder::setBufferSize (const size_t size)
+{
+    _bufferSize.store(size, std::memory_order_relaxed);
+}
+
+bool LogFlightRecorder::setDumpPath (const std::string &path)
+{
+    int fd = -1;
+
+    if (!path.empty()) {
+#if defined(_WIN32)
+        fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY,
+                   0644);
+#else
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                    0644);
+#endif // defined(_WIN32)
+        if (fd < 0) {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_dumpMutex);
+
+    int old = _fd.exchange(fd);
+    if (old >= 0) {
+#if defined(_WIN32)
+        _close(old);
+#else
+        ::close(old);
+#endif // defined(_WIN32)
+    }
+
+    return true;
+}
+
+#if defined(_WIN32)
+
+void LogFlightRecorder::setDumpOnSignal (const bool)
+{
+}
+
+#else
+
+// the recorder dumped by the signal handler
+static std::atomic<LogFlightRecorder *> signalRecorder { nullptr };
+
+static const int kFatalSignals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+static const size_t kFatalSignalCount = sizeof(kFatalSignals) / sizeof(int);
+
+// the handlers that were installed before
+static struct sigaction previousActions[kFatalSignalCount];
+
+static void handleFatalSignal (int signal)
+{
+    // dump only once, even if the dump itself crashes
+    LogFlightRecorder *recorder = signalRecorder.exchange(nullptr);
+    if (recorder != nullptr) {
+        recorder->dumpFromSignal();
+    }
+
+    // let the previous handler (or the default action) handle the signal
+    for (size_t i = 0; i < kFatalSignalCount; i++) {
+        if (kFatalSignals[i] == signal) {
+            sigaction(signal, &previousActions[i], nullptr);
+        }
+    }
+    raise(signal);
+}
+
+void LogFlightRecorder::setDumpOnSignal (const bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_dumpMutex);
+
+    if (enabled == _dumpOnSignal) {
+        return;
+    }
+    _dumpOnSignal = enabled;
+
+    if (enabled) {
+
+        signalRecorder = this;
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = handleFatalSignal;
+        action.sa_flags = SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+
+        for (size_t i = 0; i < kFatalSignalCount; i++) {
+            sigaction(kFatalSignals[i], &action, &previousActions[i]);
+        }
+
+    } else {
+
+        for (size_t i = 0; i < kFatalSignalCount; i++) {
+            sigaction(kFatalSignals[i], &previousActions[i], nullptr);
+        }
+
+        LogFlightRecorder *expected = this;
+        signalRecorder.compare_exchange_strong(expected, nullptr);
+    }
+}
+
+#endif // defined(_WIN32)
+
+void LogFlightRecorder::record (const char *prefix, const size_t prefixSize,
+                                const char *text, const size_t textSize)
+{
+    Ring *ring = threadRing();
+    if (ring == nullptr) {
+        return;
+    }
+
+    // only contended while dump() reads the buffer
+    bool expected = false;
+    while (!ring->busy.compare_exchange_weak(expected, true,
+                                             std::memory_order_acquire)) {
+        expected = false;
+        std::this_thread::yield();
+    }
+
+    appendRing(*ring, prefix, prefixSize);
+    appendRing(*ring, text, textSize);
+    appendRing(*ring, "\n", 1);
+
+    ring->busy.store(false, std::memory_order_release);
+}
+
+void LogFlightRecorder::dump ()
+{
+    std::lock_guard<std::mutex> lock(_dumpMutex);
+
+    int fd = _fd.load();
+    if (fd < 0) {
+        fd = 2;
+    }
+
+    for (Ring *ring = _rings.load(std::memory_order_acquire); ring != nullptr;
+         ring = ring->next) {
+
+        bool expected = false;
+        while (!ring->busy.compare_exchange_weak(expected, true,
+                                                 std::memory_order_acquire)) {
+            expected = false;
+            std::this_thread::yield();
+        }
+
+        writeRing(fd, *ring);
+        ring->written = 0;
+
+        ring->busy.store(false, std::memory_order_release);
+    }
+}
+
+void LogFlightRecorder::dumpFromSignal ()
+{
+    int fd = _fd.load();
+    if (fd < 0) {
+        fd = 2;
+    }
+
+    // a thread may be writing its buffer right now, the dump is done anyway
+    for (Ring *ring = _rings.load(std::memory_order_acquire); ring != nullptr;
+         ring = ring->next) {
+        writeRing(fd, *ring);
+    }
+}
+
+void LogFlightRecorder::releaseRing (Ring *ring)
+{
+    ring->inUse.store(false, std::memory_order_release);
+}
+
+// the buffer of the calling thread (claims or creates one)
+LogFlightRecorder::Ring *LogFlightRecorder::threadRing ()
+{
+    size_t size = _bufferSize.load(std::memory_order_relaxed);
+    Ring *ring = flightRingHolder.ring;
+
+    if (ring != nullptr && ring->size == size) {
+        return ring;
+    }
+
+    // the size was changed, the old buffer keeps its lines for the next dump
+    // (unless another thread reuses it before)
+    if (ring != nullptr) {
+        releaseRing(ring);
+        flightRingHolder.ring = nullptr;
+    }
+
+    if (size == 0) {
+        return nullptr;
+    }
+
+    // reuse the buffer of an exited thread, its lines are dropped (they
+    // would be dumped under the number of the new thread)
+    for (ring = _rings.load(std::memory_order_acquire); ring != nullptr;
+         ring = ring->next) {
+        bool expected = false;
+        if (ring->size == size &&
+            ring->inUse.compare_exchange_strong(expected, true,
+                                                std::memory_order_acquire)) {
+
+            // dump() may be reading the buffer right now
+            while (!ring->busy.compare_exchange_weak(expected, true,
+                                                     std::memory_order_acquire)) {
+                expected = false;
+                std::this_thread::yield();
+            }
+            ring->written = 0;
+            ring->thread = ++_threadCount;
+            ring->busy.store(false, std::memory_order_release);
+
+            flightRingHolder.ring = ring;
+            return ring;
+        }
+    }
+
+    ring = new Ring();
+    ring->data.reset(new char[size]);
+    ring->size = size;
+    ring->thread = ++_threadCount;
+
+    ring->next = _rings.load(std::memory_order_relaxed);
+    while (!_rings.compare_exchange_weak(ring->next, ring,
+                                         std::memory_order_release)) {
+    }
+
+    flightRingHolder.ring = ring;
+    return ring;
+}
+
+// writes the content of a buffer (async-signal-safe)
+void LogFlightRecorder::writeRing (const int fd, const Ring &ring)
+{
+    size_t written = ring.written;
+    if (written == 0) {
+        return;
+    }
+
+    char header[64];
+    const char title[] = "--- flight recorder of thread ";
+    size_t length = sizeof(title) - 1;
+    memcpy(header, title, length);
+    length = appendNumber(header, length, ring.thread);
+    memcpy(header + length, " ---\n", 5);
+    writeAll(fd, header, length + 5);
+
+    const char *data = ring.data.get();
+
+    if (written <= ring.size) {
+        writeAll(fd, data, written);
+        return;
+    }
+
+    // the oldest line was partly overwritten, start after its end
+    size_t position = written % ring.size;
+    size_t skip = 0;
+    while (skip < ring.size && data[(position + skip) % ring.size] != '\n') {
+        skip++;
+    }
+    skip++;
+
+    size_t start = (position + skip) % ring.size;
+    size_t size = ring.size > skip ? ring.size - skip : 0;
+    size_t first = std::min(size, ring.size - start);
+
+    writeAll(fd, data + start, first);
+    writeAll(fd, data, size - first);
+}
@@ -0,0 +1,109 @@
+/*
+ RGPUtils
+ LogFlightRecorder.h
+
+ Keeps the most recent lines of every thread in a fixed size circular buffer
+ in memory and writes them out on request (see Log::useFlightRecorder()).
+ Writing a line only locks the buffer of the calling thread, dumping from a
+ signal handler takes no locks and only uses write().
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogFlightRecorder_H__
+#define __RGPUtils__LogFlightRecorder_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace rgp {
+
+    class LogFlightRecorder {
+
+    public:
+        LogFlightRecorder () {}
+
+        // closes the dump file and frees all buffers
+        ~LogFlightRecorder ();
+
+        LogFlightRecorder (const LogFlightRecorder &) = delete;
+        LogFlightRecorder &operator = (const LogFlightRecorder &) = delete;
+
+        // sets the size of the buffers of threads that record their first
+        // line from now on (0 stops recording)
+        void setBufferSize (const size_t size);
+
+        // opens the file the dumps are appended to (empty = stderr),
+        // returns false if it can't be opened
+        bool setDumpPath (const std::string &path);
+
+        // installs or removes the handler of fatal signals
+        void setDumpOnSignal (const bool enabled);
+
+        // appends a line to the buffer of the calling thread (the newline is
+        // added)
+        void record (const char *prefix, const size_t prefixSize,
+                     const char *text, const size_t textSize);
+
+        // writes the buffers of all threads to the dump file and empties them
+        void dump ();
+
+        // same as dump() but async-signal-safe: takes no locks and doesn't
+        // empty the buffers
+        void dumpFromSignal ();
+
+        // the buffer of a thread
+        struct Ring;
+
+        // gives the buffer of an exiting thread to the next new thread
+        static void releaseRing (Ring *ring);
+
+    private:
+        // all buffers ever created, new ones are pushed to the front and
+        // never removed while the recorder exists
+        std::atomic<Ring *> _rings { nullptr };
+
+        // size of new buffers
+        std::atomic<size_t> _bufferSize { 0 };
+
+        // numbers the threads in the dumps
+        std::atomic<uint64_t> _threadCount { 0 };
+
+        // file descriptor of the dump file (-1 = stderr)
+        std::atomic<int> _fd { -1 };
+
+        // serializes dump() and changes of the dump file
+        std::mutex _dumpMutex;
+
+        // true if the signal handler is installed
+        bool _dumpOnSignal { false };
+
+        // the buffer of the calling thread (claims or creates one)
+        Ring *threadRing ();
+
+        // writes the content of a buffer (async-signal-safe)
+        static void writeRing (const int fd, const Ring &ring);
+    };
+}
+
+#endif // defined(__RGPUtils__LogFlightRecorder_H__) header guard
@@ -0,0 +1,478 @@
+/*
+ RGPUtils
+ LogFormat.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include <rgp/LogFormat.h>
+
+#include "LogBinaryFormat.h"
+
+#include <cmath>    // log10 / nearbyint / isfinite
+#include <cstdio>   // snprintf
+
+using namespace rgp;
+
+// two digits at once for the integer conversion
+static const char kDigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// writes the digits of value to the end of the buffer, returns the start
+static char *formatUnsigned (char *end, uint64_t value)
+{
+    char *c = end;
+
+    while (value >= 100) {
+        unsigned int pair = (unsigned int)(value % 100) * 2;
+        value /= 100;
+        *--c = kDigitPairs[pair + 1];
+        *--c = kDigitPairs[pair];
+    }
+
+    if (value >= 10) {
+        unsigned int pair = (unsigned int)value * 2;
+        *--c = kDigitPairs[pair + 1];
+        *--c = kDigitPairs[pair];
+    } else {
+        *--c = (char)('0' + value);
+    }
+
+    return c;
+}
+
+static void appendUnsigned (std::string &output, const uint64_t value)
+{
+    char buffer[24];
+    char *end = buffer + sizeof(buffer);
+    char *start = formatUnsigned(end, value);
+    output.append(start, end - start);
+}
+
+static void appendSigned (std::string &output, const int64_t value)
+{
+    char buffer[24];
+    char *end = buffer + sizeof(buffer);
+
+    // negate as unsigned, so INT64_MIN works too
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    char *start = formatUnsigned(end, magnitude);
+    if (value < 0) {
+        *--start = '-';
+    }
+
+    output.append(start, end - start);
+}
+
+static void appendHex (std::string &output, uint64_t value)
+{
+    static const char kHexDigits[] = "0123456789abcdef";
+
+    char buffer[24];
+    char *end = buffer + sizeof(buffer);
+    char *c = end;
+
+    do {
+        *--c = kHexDigits[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+
+    *--c = 'x';
+    *--c = '0';
+
+    output.append(c, end - c);
+}
+
+// appends a double like %g with snprintf
+static void appendDoubleSlow (std::string &output, const double value)
+{
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%g", value);
+    if (length > 0) {
+        output.append(buffer, (size_t)length);
+    }
+}
+
+// formats like printf("%g") (6 significant digits)
+static void appendDouble (std::string &output, const double value)
+{
+    static const double kPowersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10
+    };
+
+    if (value == 0.0) {
+        output.append(std::signbit(value) ? "-0" : "0");
+        return;
+    }
+
+    double magnitude = std::fabs(value);
+
+    // fast path for the usual range without exponent, the rest (and
+    // infinity / nan) is left to snprintf
+    if (std::isfinite(magnitude) && magnitude >= 1e-4 && magnitude < 1e5) {
+
+        int exponent = (int)std::floor(std::log10(magnitude));
+        int decimals = 5 - exponent;
+
+        // the multiplication isn't exact, a value close to a tie may become
+        // one (f.e. 1131.585 is stored as 1131.58500000000004, printf
+        // prints 1131.59 but the product is exactly 113158.5 and would be
+        // rounded to even), so these are left to snprintf
+        double scaled = magnitude * kPowersOfTen[decimals];
+        if (std::fabs(scaled - std::floor(scaled) - 0.5) < 1e-6) {
+            appendDoubleSlow(output, value);
+            return;
+        }
+        uint64_t digits = (uint64_t)std::nearbyint(scaled);
+
+        // rounding gave one more digit (f.e. 9.999999 -> 10.0000)
+        if (digits >= 1000000) {
+            if (exponent + 1 >= 5) {
+                digits = 0;
+            } else {
+                digits = (digits + 5) / 10;
+                decimals--;
+            }
+        }
+
+        if (digits > 0) {
+
+            // strip trailing zeros of the fraction
+            while (decimals > 0 && digits % 10 == 0) {
+                digits /= 10;
+                decimals--;
+            }
+
+            char buffer[32];
+            char *end = buffer + sizeof(buffer);
+            char *c = formatUnsigned(end, digits);
+
+            if (decimals > 0) {
+                // pad with zeros up to the decimal point (f.e. 0.00123)
+                while (end - c <= decimals) {
+                    *--c = '0';
+                }
+                // move the integer part one to the left for the point
+                char *point = end - decimals;
+                memmove(c - 1, c, point - c);
+                c--;
+                *(point - 1) = '.';
+            }
+
+            if (value < 0) {
+                *--c = '-';
+            }
+
+            output.append(c, end - c);
+            return;
+        }
+    }
+
+    appendDoubleSlow(output, value);
+}
+
+// appends a single argument as text
+static void appendArgument (std::string &output, const LogArgument &argument)
+{
+    switch (argument.type()) {
+        case LogArgumentTypeInt: {
+            appendSigned(output, argument.intValue());
+        } break;
+
+        case LogArgumentTypeUInt: {
+            appendUnsigned(output, argument.uintValue());
+        } break;
+
+        case LogArgumentTypeDouble: {
+            appendDouble(output, argument.doubleValue());
+        } break;
+
+        case LogArgumentTypeBool: {
+            output.append(argument.uintValue() ? "true" : "false");
+        } break;
+
+        case LogArgumentTypeChar: {
+            output.push_back((char)argument.uintValue());
+        } break;
+
+        case LogArgumentTypeString: {
+            output.append(argument.stringData(), argument.stringSize());
+        } break;
+
+        case LogArgumentTypePointer: {
+            appendHex(output, argument.uintValue());
+        } break;
+
+        default: break;
+    }
+}
+
+void rgp::formatLogMessage (std::string &output, const char *format,
+                            const LogArgument *arguments, const size_t count)
+{
+    size_t next = 0;
+    const char *start = format;
+    const char *c = format;
+
+    while (*c != '\0') {
+
+        if (c[0] == '{' && c[1] == '}' && next < count) {
+            output.append(start, c - start);
+            appendArgument(output, arguments[next++]);
+            c += 2;
+            start = c;
+        } else if ((c[0] == '{' && c[1] == '{') || (c[0] == '}' && c[1] == '}')) {
+            // escaped brace -> keep only one of them
+            output.append(start, c - start + 1);
+            c += 2;
+            start = c;
+        } else {
+            c++;
+        }
+    }
+
+    output.append(start, c - start);
+}
+
+// hex digits for escaped control characters
+static const char kHexDigits[] = "0123456789abcdef";
+
+// appends a JSON string including the quotes
+static void appendJsonString (std::string &output, const char *data,
+                              const size_t size)
+{
+    output.push_back('"');
+
+    const char *start = data;
+    const char *end = data + size;
+
+    for (const char *c = data; c < end; c++) {
+
+        unsigned char character = (unsigned char)*c;
+        if (character >= 0x20 && character != '"' && character != '\\') {
+            continue;
+        }
+
+        output.append(start, c - start);
+        start = c + 1;
+
+        switch (character) {
+            case '"': output.append("\\\""); break;
+            case '\\': output.append("\\\\"); break;
+            case '\n': output.append("\\n"); break;
+            case '\r': output.append("\\r"); break;
+            case '\t': output.append("\\t"); break;
+            default: {
+                char escaped[6] = { '\\', 'u', '0', '0',
+                                    kHexDigits[character >> 4],
+                                    kHexDigits[character & 0xf] };
+                output.append(escaped, sizeof(escaped));
+            } break;
+        }
+    }
+
+    output.append(start, end - start);
+    output.push_back('"');
+}
+
+// appends a logfmt value, quoted only if it contains special characters
+static void appendLogfmtString (std::string &output, const char *data,
+                                const size_t size)
+{
+    bool needsQuotes = size == 0;
+    for (size_t i = 0; i < size && !needsQuotes; i++) {
+        unsigned char character = (unsigned char)data[i];
+        needsQuotes = character <= ' ' || character == '=' ||
+                      character == '"' || character == '\\';
+    }
+
+    if (!needsQuotes) {
+        output.append(data, size);
+        return;
+    }
+
+    // same escaping as JSON
+    appendJsonString(output, data, size);
+}
+
+// appends a field value in the given encoding
+static void appendFieldValue (std::string &output,
+                              const LogStructuredFormat format,
+                              const LogArgument &value)
+{
+    const bool json = format == LogStructuredFormatJson;
+
+    switch (value.type()) {
+        case LogArgumentTypeDouble: {
+            // JSON has no representation for nan and infinity
+            if (json && !std::isfinite(value.doubleValue())) {
+                output.append("null");
+            } else {
+                appendDouble(output, value.doubleValue());
+            }
+        } break;
+
+        case LogArgumentTypeChar: {
+            char character = (char)value.uintValue();
+            if (json) {
+                appendJsonString(output, &character, 1);
+            } else {
+                appendLogfmtString(output, &character, 1);
+            }
+        } break;
+
+        case LogArgumentTypeString: {
+            if (json) {
+                appendJsonString(output, value.stringData(), value.stringSize());
+            } else {
+                appendLogfmtString(output, value.stringData(), value.stringSize());
+            }
+        } break;
+
+        case LogArgumentTypePointer: {
+            if (json) {
+                output.push_back('"');
+            }
+            appendHex(output, value.uintValue());
+            if (json) {
+                output.push_back('"');
+            }
+        } break;
+
+        case LogArgumentTypeNone: {
+            output.append(json ? "null" : "\"\"");
+        } break;
+
+        default: {
+            appendArgument(output, value);
+        } break;
+    }
+}
+
+void rgp::encodeLogFields (std::string &output, const LogStructuredFormat format,
+                           const char *time, const size_t timeSize,
+                           const char *level, const char *message,
+                           const size_t messageSize, const LogField *fields,
+                           const size_t count)
+{
+    if (format == LogStructuredFormatJson) {
+
+        output.append("{\"ts\":\"");
+        output.append(time, timeSize);
+        output.append("\",\"level\":\"");
+        output.append(level);
+        output.append("\",\"msg\":");
+        appendJsonString(output, message, messageSize);
+
+        for (size_t i = 0; i < count; i++) {
+            output.push_back(',');
+            appendJsonString(output, fields[i].key, strlen(fields[i].key));
+            output.push_back(':');
+            appendFieldValue(output, format, fields[i].value);
+        }
+
+        output.push_back('}');
+        return;
+    }
+
+    output.append("ts=");
+    output.append(time, timeSize);
+    output.append(" level=");
+    output.append(level);
+    output.append(" msg=");
+    appendLogfmtString(output, message, messageSize);
+
+    for (size_t i = 0; i < count; i++) {
+        output.push_back(' ');
+        output.append(fields[i].key);
+        output.push_back('=');
+        appendFieldValue(output, format, fields[i].value);
+    }
+}
+
+void rgp::encodeLogBinaryFormat (std::string &output, const uint32_t id,
+                                 const std::string &format)
+{
+    output.push_back(kLogBinaryFormatTag);
+    appendLogBinaryValue<uint32_t>(output, id);
+    appendLogBinaryValue<uint32_t>(output, (uint32_t)format.size());
+    output.append(format);
+}
+
+void rgp::encodeLogBinaryEvent (std::string &output, const uint32_t id,
+                                const int64_t timestamp, const uint8_t level,
+                                const uint8_t flags,
+                                const LogArgument *arguments,
+                                const size_t count)
+{
+    // more arguments can't be referenced by a format string in practice
+    const uint8_t argumentCount = count > 255 ? 255 : (uint8_t)count;
+
+    output.push_back(kLogBinaryEventTag);
+    appendLogBinaryValue<uint32_t>(output, id);
+    appendLogBinaryValue<int64_t>(output, timestamp);
+    appendLogBinaryValue<uint8_t>(output, level);
+    appendLogBinaryValue<uint8_t>(output, flags);
+    appendLogBinaryValue<uint8_t>(output, argumentCount);
+
+    for (size_t i = 0; i < argumentCount; i++) {
+
+        const LogArgument &argument = arguments[i];
+        appendLogBinaryValue<uint8_t>(output, argument.type());
+
+        switch (argument.type()) {
+            case LogArgumentTypeInt: {
+                appendLogBinaryValue<int64_t>(output, argument.intValue());
+            } break;
+
+            case LogArgumentTypeDouble: {
+                appendLogBinaryValue<double>(output, argument.doubleValue());
+            } break;
+
+            case LogArgumentTypeUInt:
+            case LogArgumentTypePointer: {
+                appendLogBinaryValue<uint64_t>(output, argument.uintValue());
+            } break;
+
+            case LogArgumentTypeBool:
+            case LogArgumentTypeChar: {
+                appendLogBinaryValue<uint8_t>(output,
+                                              (uint8_t)argument.uintValue());
+            } break;
+
+            case LogArgumentTypeString: {
+                appendLogBinaryValue<uint32_t>(output,
+                                               (uint32_t)argument.stringSize());
+                output.append(argument.stringData(), argument.stringSize());
+            } break;
+
+            default: break;
+        }
+    }
+}
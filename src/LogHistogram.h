@@ -0,0 +1,129 @@
+/*
+ RGPUtils
+ LogHistogram.h
+
+ Collects durations into power of two buckets with relaxed atomic
+ operations, so it can be updated from several threads without a lock.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogHistogram_H__
+#define __RGPUtils__LogHistogram_H__
+
+#include <rgp/LogMetrics.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace rgp {
+
+    class LogHistogram {
+
+    public:
+        LogHistogram ()
+        {
+            reset();
+        }
+
+        LogHistogram (const LogHistogram &) = delete;
+        LogHistogram &operator = (const LogHistogram &) = delete;
+
+        // monotonic time for measuring durations
+        static uint64_t now ()
+        {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void record (const uint64_t nanoseconds)
+        {
+            // the bucket is the number of significant bits
+            size_t bucket = 0;
+            while (bucket < LogLatencyHistogram::kBucketCount - 1 &&
+                   (nanoseconds >> bucket) != 0) {
+                bucket++;
+            }
+
+            _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            _count.fetch_add(1, std::memory_order_relaxed);
+            _total.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+            uint64_t max = _max.load(std::memory_order_relaxed);
+            while (nanoseconds > max &&
+                   !_max.compare_exchange_weak(max, nanoseconds,
+                                               std::memory_order_relaxed)) {
+            }
+        }
+
+        void snapshot (LogLatencyHistogram &histogram) const
+        {
+            for (size_t i = 0; i < LogLatencyHistogram::kBucketCount; i++) {
+                histogram.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+            }
+            histogram.count = _count.load(std::memory_order_relaxed);
+            histogram.totalNanoseconds = _total.load(std::memory_order_relaxed);
+            histogram.maxNanoseconds = _max.load(std::memory_order_relaxed);
+        }
+
+        void reset ()
+        {
+            for (auto &bucket : _buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            _count.store(0, std::memory_order_relaxed);
+            _total.store(0, std::memory_order_relaxed);
+            _max.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> _buckets[LogLatencyHistogram::kBucketCount];
+        std::atomic<uint64_t> _count;
+        std::atomic<uint64_t> _total;
+        std::atomic<uint64_t> _max;
+    };
+
+    // measures the time until the end of the scope (nothing if the
+    // histogram is null)
+    class LogLatencyScope {
+
+    public:
+        explicit LogLatencyScope (LogHistogram *histogram)
+        : _histogram(histogram), _start(histogram != nullptr ? LogHistogram::now() : 0)
+        {}
+
+        ~LogLatencyScope ()
+        {
+            if (_histogram != nullptr) {
+                _histogram->record(LogHistogram::now() - _start);
+            }
+        }
+
+        LogLatencyScope (const LogLatencyScope &) = delete;
+        LogLatencyScope &operator = (const LogLatencyScope &) = delete;
+
+    private:
+        LogHistogram *_histogram;
+        uint64_t _start;
+    };
+}
+
+#endif // defined(__RGPUtils__LogHistogram_H__) header guard
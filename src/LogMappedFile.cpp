@@ -0,0 +1,241 @@
+/*
+ RGPUtils
+ LogMappedFile.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LogMappedFile.h"
+
+#include <algorithm> // std::min
+#include <cstring>   // memcpy
+#include <thread>    // yield
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // !defined(_WIN32)
+
+using namespace rgp;
+
+LogMappedFile::~LogMappedFile ()
+{
+    close();
+}
+
+bool LogMappedFile::isSupported ()
+{
+#if defined(_WIN32)
+    return false;
+#else
+    return true;
+#endif // defined(_WIN32)
+}
+
+#if defined(_WIN32)
+
+bool LogMappedFile::open (const std::string &, const size_t)
+{
+    return false;
+}
+
+void LogMappedFile::close ()
+{
+}
+
+bool LogMappedFile::write (const char *, size_t)
+{
+    return false;
+}
+
+LogMappedFile::Segment *LogMappedFile::createSegment ()
+{
+    return nullptr;
+}
+
+bool LogMappedFile::startNextSegment (Segment *)
+{
+    return false;
+}
+
+void LogMappedFile::retireSegment (Segment *)
+{
+}
+
+#else
+
+bool LogMappedFile::open (const std::string &path, const size_t segmentSize)
+{
+    close();
+
+    std::lock_guard<std::mutex> lock(_segmentMutex);
+
+    _path = path;
+    _segmentSize = segmentSize;
+
+    // don't overwrite the segments of earlier runs
+    _nextIndex = 0;
+    struct stat info;
+    while (stat((_path + "." + std::to_string(_nextIndex)).c_str(), &info) == 0) {
+        _nextIndex++;
+    }
+
+    Segment *segment = createSegment();
+    _current.store(segment, std::memory_order_seq_cst);
+
+    return segment != nullptr;
+}
+
+void LogMappedFile::close ()
+{
+    std::lock_guard<std::mutex> lock(_segmentMutex);
+
+    Segment *segment = _current.exchange(nullptr, std::memory_order_seq_cst);
+    if (segment != nullptr) {
+        retireSegment(segment);
+    }
+}
+
+bool LogMappedFile::write (const char *data, size_t size)
+{
+    for (;;) {
+
+        Segment *segment = _current.load(std::memory_order_seq_cst);
+        if (segment == nullptr) {
+            return false;
+        }
+
+        // announce the writer, then make sure the segment wasn't replaced in
+        // the meantime (pairs with retireSegment(), which first replaces the
+        // segment and then waits for the writers)
+        segment->writers.fetch_add(1, std::memory_order_seq_cst);
+        if (_current.load(std::memory_order_seq_cst) != segment) {
+            segment->writers.fetch_sub(1, std::memory_order_release);
+            continue;
+        }
+
+        // a line never spans two segments
+        size = std::min(size, segment->size);
+
+        size_t offset = segment->position.fetch_add(size,
+                                                    std::memory_order_relaxed);
+
+        if (offset + size <= segment->size) {
+            memcpy(segment->data + offset, data, size);
+            segment->writers.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+
+        // only one writer crosses the end, everything behind it is unused
+        if (offset < segment->size) {
+            segment->end.store(offset, std::memory_order_relaxed);
+        }
+
+        segment->writers.fetch_sub(1, std::memory_order_release);
+
+        if (!startNextSegment(segment)) {
+            return false;
+        }
+    }
+}
+
+// creates and maps the next segment (nullptr on error)
+LogMappedFile::Segment *LogMappedFile::createSegment ()
+{
+    std::string path = _path + "." + std::to_string(_nextIndex);
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    // reserve the blocks now, so writing into the mapping can't fail later
+#if defined(__linux__)
+    bool allocated = posix_fallocate(fd, 0, (off_t)_segmentSize) == 0;
+#else
+    bool allocated = ftruncate(fd, (off_t)_segmentSize) == 0;
+#endif // defined(__linux__)
+
+    void *data = allocated ? mmap(nullptr, _segmentSize, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, 0)
+                           : MAP_FAILED;
+
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        ::unlink(path.c_str());
+        return nullptr;
+    }
+
+    std::unique_ptr<Segment> segment { new Segment() };
+    segment->fd = fd;
+    segment->data = static_cast<char *>(data);
+    segment->size = _segmentSize;
+    segment->end.store(_segmentSize, std::memory_order_relaxed);
+
+    _nextIndex++;
+    _segments.push_back(std::move(segment));
+
+    return _segments.back().get();
+}
+
+// replaces the full segment by a new one
+bool LogMappedFile::startNextSegment (Segment *full)
+{
+    std::lock_guard<std::mutex> lock(_segmentMutex);
+
+    // another writer was faster (or the file was closed)
+    Segment *current = _current.load(std::memory_order_seq_cst);
+    if (current != full) {
+        return current != nullptr;
+    }
+
+    Segment *next = createSegment();
+    _current.store(next, std::memory_order_seq_cst);
+
+    retireSegment(full);
+
+    return next != nullptr;
+}
+
+// waits for the writers of a replaced segment and unmaps it
+void LogMappedFile::retireSegment (Segment *segment)
+{
+    // writers only copy a single line
+    while (segment->writers.load(std::memory_order_seq_cst) > 0) {
+        std::this_thread::yield();
+    }
+
+    size_t used = std::min(segment->position.load(std::memory_order_relaxed),
+                           segment->end.load(std::memory_order_relaxed));
+
+    munmap(segment->data, segment->size);
+    segment->data = nullptr;
+
+    // remove the preallocated but unused part
+    if (ftruncate(segment->fd, (off_t)used) != 0) {
+        // keep the zeros at the end
+    }
+    ::close(segment->fd);
+    segment->fd = -1;
+}
+
+#endif // defined(_WIN32)
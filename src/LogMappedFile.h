@@ -0,0 +1,105 @@
+/*
+ RGPUtils
+ LogMappedFile.h
+
+ A logfile that is written through memory mappings. The file consists of
+ preallocated segments ("<path>.<n>"). Writers reserve a range of the current
+ segment with a single atomic addition and copy their line into the mapping,
+ no system call and no lock is needed per line. The data stays in the page
+ cache even if the process crashes. A full segment is truncated to the used
+ size and the next segment is started.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogMappedFile_H__
+#define __RGPUtils__LogMappedFile_H__
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rgp {
+
+    class LogMappedFile {
+
+    public:
+        LogMappedFile () {}
+        ~LogMappedFile ();
+
+        LogMappedFile (const LogMappedFile &) = delete;
+        LogMappedFile &operator = (const LogMappedFile &) = delete;
+
+        // false on platforms without mmap
+        static bool isSupported ();
+
+        // starts the first segment after the existing ones of the path
+        bool open (const std::string &path, const size_t segmentSize);
+
+        // truncates the current segment to the used size (waits for writers)
+        void close ();
+
+        // copies the data into the current segment (thread-safe, lock-free
+        // unless a new segment has to be started), returns false if the
+        // file is closed or no segment could be created
+        bool write (const char *data, size_t size);
+
+    private:
+        struct Segment {
+            int fd { -1 };
+            char *data { nullptr };
+            size_t size { 0 };
+
+            // next free byte (grows beyond size when the segment is full)
+            std::atomic<size_t> position { 0 };
+
+            // end of the data, set by the writer that didn't fit anymore
+            std::atomic<size_t> end { 0 };
+
+            // writers that are copying into the segment right now
+            std::atomic<int> writers { 0 };
+        };
+
+        std::atomic<Segment *> _current { nullptr };
+
+        // starting new segments (protects the members below)
+        std::mutex _segmentMutex;
+        std::string _path;
+        size_t _segmentSize { 0 };
+        unsigned int _nextIndex { 0 };
+
+        // all segments ever created, a writer may still hold a pointer to an
+        // old one after it was replaced (only unmapped, never deleted)
+        std::vector<std::unique_ptr<Segment>> _segments;
+
+        // creates and maps the next segment (nullptr on error)
+        Segment *createSegment ();
+
+        // replaces the full segment by a new one
+        bool startNextSegment (Segment *full);
+
+        // waits for the writers of a replaced segment and unmaps it
+        static void retireSegment (Segment *segment);
+    };
+}
+
+#endif // defined(__RGPUtils__LogMappedFile_H__) header guard
@@ -0,0 +1,171 @@
+/*
+ RGPUtils
+ LogMetrics.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include <rgp/LogMetrics.h>
+
+#include <cstring> // memset
+
+using namespace rgp;
+
+// names of the levels in the JSON encoding
+static const char *kLevelNames[] = {
+    "off", "error", "warning", "info", "debug", "trace"
+};
+
+// LogLatencyHistogram
+
+LogLatencyHistogram::LogLatencyHistogram ()
+: count(0), totalNanoseconds(0), maxNanoseconds(0)
+{
+    memset(buckets, 0, sizeof(buckets));
+}
+
+uint64_t LogLatencyHistogram::percentile (const double p) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(p * (double)count);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        seen += buckets[i];
+        if (seen > rank) {
+            // the longest duration is a better bound for the last bucket
+            uint64_t bound = i > 0 ? (1ULL << i) - 1 : 0;
+            return bound < maxNanoseconds ? bound : maxNanoseconds;
+        }
+    }
+
+    return maxNanoseconds;
+}
+
+// LogMetrics
+
+LogMetrics::LogMetrics ()
+: timestamp(0), flushes(0), queueDepth(0), queueCapacity(0)
+{
+    memset(lines, 0, sizeof(lines));
+    memset(bytes, 0, sizeof(bytes));
+    memset(dropped, 0, sizeof(dropped));
+}
+
+// appends "name": {"error": .., ...} for a counter per level
+static void appendLevels (std::string &json, const char *name,
+                          const uint64_t *counts)
+{
+    json += "\"";
+    json += name;
+    json += "\":{";
+    for (int level = LoglevelError; level <= LoglevelTrace; level++) {
+        if (level > LoglevelError) {
+            json += ",";
+        }
+        json += "\"";
+        json += kLevelNames[level];
+        json += "\":";
+        json += std::to_string(counts[level]);
+    }
+    json += "}";
+}
+
+static void appendHistogram (std::string &json, const char *name,
+                             const LogLatencyHistogram &histogram)
+{
+    uint64_t mean = histogram.count > 0 ? histogram.totalNanoseconds / histogram.count
+                                        : 0;
+
+    json += "\"";
+    json += name;
+    json += "\":{\"count\":";
+    json += std::to_string(histogram.count);
+    json += ",\"mean_ns\":";
+    json += std::to_string(mean);
+    json += ",\"p50_ns\":";
+    json += std::to_string(histogram.percentile(0.5));
+    json += ",\"p99_ns\":";
+    json += std::to_string(histogram.percentile(0.99));
+    json += ",\"p999_ns\":";
+    json += std::to_string(histogram.percentile(0.999));
+    json += ",\"max_ns\":";
+    json += std::to_string(histogram.maxNanoseconds);
+    json += "}";
+}
+
+static void appendMutex (std::string &json, const char *name,
+                         const LogMutexMetrics &mutex)
+{
+    json += "\"";
+    json += name;
+    json += "\":{\"contended\":";
+    json += std::to_string(mutex.contended);
+    json += ",\"wait_ns\":";
+    json += std::to_string(mutex.waitNanoseconds);
+    json += "}";
+}
+
+std::string LogMetrics::toJson () const
+{
+    std::string json;
+    json.reserve(1024);
+
+    json += "{\"timestamp\":";
+    json += std::to_string(timestamp);
+    json += ",";
+    appendLevels(json, "lines", lines);
+    json += ",";
+    appendLevels(json, "bytes", bytes);
+    json += ",";
+    appendLevels(json, "dropped", dropped);
+    json += ",\"flushes\":";
+    json += std::to_string(flushes);
+    json += ",";
+    appendMutex(json, "output_mutex", outputMutex);
+    json += ",";
+    appendMutex(json, "error_mutex", errorMutex);
+    json += ",\"queue_depth\":";
+    json += std::to_string(queueDepth);
+    json += ",\"queue_capacity\":";
+    json += std::to_string(queueCapacity);
+    json += ",";
+    appendHistogram(json, "output_latency", outputLatency);
+    json += ",";
+    appendHistogram(json, "error_latency", errorLatency);
+    json += ",\"sinks\":[";
+    for (size_t i = 0; i < sinks.size(); i++) {
+        if (i > 0) {
+            json += ",";
+        }
+        json += "{";
+        appendHistogram(json, "write_latency", sinks[i].writeLatency);
+        json += "}";
+    }
+    json += "]}";
+
+    return json;
+}
@@ -0,0 +1,75 @@
+/*
+ RGPUtils
+ LogRecord.h
+
+ A single log entry as it travels from the logging call to the output.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogRecord_H__
+#define __RGPUtils__LogRecord_H__
+
+#include <rgp/Log.h>
+
+#include <cstdint>
+#include <string>
+
+namespace rgp {
+
+    /** Describes where a record has to go. */
+    typedef enum : uint8_t {
+        /** Normal output (std::cout or logfile) */
+        LogRecordKindOutput = 0,
+        /** Error output (std::cerr or errorfile) */
+        LogRecordKindError,
+        /** Already formatted lines for the normal output (thread buffers) */
+        LogRecordKindOutputChunk,
+        /** Encoded entries for the binary logfile */
+        LogRecordKindBinary,
+        /** Format definitions for the binary logfile (never dropped, the
+            events that follow can't be decoded without them) */
+        LogRecordKindBinaryFormat,
+        /** No output, marks a flush request of the async queue */
+        LogRecordKindFlush
+    } LogRecordKind;
+
+    struct LogRecord {
+        LogRecordKind kind { LogRecordKindOutput };
+        Loglevel level { LoglevelNormal };
+        AnsiSgrFgColor fgcolor { AnsiSgrFgColorDefault };
+        AnsiSgrBgColor bgcolor { AnsiSgrBgColorDefault };
+
+        // time of the logging call in nanoseconds since the epoch
+        // (not the time of writing)
+        int64_t timestamp { 0 };
+
+        // flush ticket for LogRecordKindFlush records
+        uint64_t ticket { 0 };
+
+        // the text is an encoded structured record that contains the time
+        // itself, so no timestamp is written in front of it
+        bool structured { false };
+
+        std::string text;
+    };
+}
+
+#endif // defined(__RGPUtils__LogRecord_H__) header guard
@@ -0,0 +1,203 @@
+/*
+ RGPUtils
+ LogRingBuffer.h
+
+ A bounded lock-free multi-producer queue used by the asynchronous Log
+ backend. Based on the well known bounded MPMC queue by Dmitry Vyukov: every
+ cell carries a sequence number, so producers only need a single
+ compare-and-swap on the enqueue position and never wait on each other.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogRingBuffer_H__
+#define __RGPUtils__LogRingBuffer_H__
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace rgp {
+
+    template <typename T>
+    class LogRingBuffer {
+
+    public:
+
+        // the capacity will be rounded up to the next power of two
+        explicit LogRingBuffer (const size_t capacity)
+        {
+            size_t size = 2;
+            while (size < capacity) {
+                size <<= 1;
+            }
+
+            _mask = size - 1;
+            _cells.reset(new Cell[size]);
+
+            for (size_t i = 0; i < size; i++) {
+                _cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        LogRingBuffer (const LogRingBuffer &) = delete;
+        LogRingBuffer &operator = (const LogRingBuffer &) = delete;
+
+        // moves the value into the queue, returns false if the queue is full
+        // (values are swapped with the cell, so memory of values taken out
+        // earlier is handed back instead of being freed), the tag can be
+        // checked by tryPopIf()
+        bool tryPush (T &value, const uint8_t tag = 0)
+        {
+            Cell *cell;
+            size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+
+            for (;;) {
+                cell = &_cells[pos & _mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+                if (diff == 0) {
+                    // cell is free -> try to claim it
+                    if (_enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                                          std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    // queue is full
+                    return false;
+                } else {
+                    // another producer was faster
+                    pos = _enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            using std::swap;
+            swap(cell->value, value);
+            cell->tag.store(tag, std::memory_order_relaxed);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // moves the oldest value out of the queue, returns false if empty
+        // (the previous content of value stays in the cell for reuse)
+        bool tryPop (T &value)
+        {
+            Cell *cell;
+            size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+
+            for (;;) {
+                cell = &_cells[pos & _mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+                if (diff == 0) {
+                    if (_dequeuePos.compare_exchange_weak(pos, pos + 1,
+                                                          std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    // queue is empty
+                    return false;
+                } else {
+                    pos = _dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            using std::swap;
+            swap(value, cell->value);
+            cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // moves the oldest value out of the queue if accept(tag) is true for
+        // its tag, returns false if empty or not accepted (the value isn't
+        // read before it is taken out, other consumers may swap it)
+        template <typename Accept>
+        bool tryPopIf (T &value, Accept accept)
+        {
+            Cell *cell;
+            size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+
+            for (;;) {
+                cell = &_cells[pos & _mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+                if (diff == 0) {
+                    // the tag belongs to pos as long as the position wasn't
+                    // taken, which the exchange below checks
+                    if (!accept(cell->tag.load(std::memory_order_relaxed))) {
+                        return false;
+                    }
+                    if (_dequeuePos.compare_exchange_weak(pos, pos + 1,
+                                                          std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    // queue is empty
+                    return false;
+                } else {
+                    pos = _dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            using std::swap;
+            swap(value, cell->value);
+            cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // number of queued elements (only a snapshot while producers are active)
+        size_t size () const
+        {
+            size_t enqueued = _enqueuePos.load(std::memory_order_relaxed);
+            size_t dequeued = _dequeuePos.load(std::memory_order_relaxed);
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+
+        size_t capacity () const
+        {
+            return _mask + 1;
+        }
+
+    private:
+
+        struct Cell {
+            std::atomic<size_t> sequence;
+            std::atomic<uint8_t> tag;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> _cells;
+        size_t _mask { 0 };
+
+        // keep producer and consumer positions on separate cache lines
+        alignas(64) std::atomic<size_t> _enqueuePos { 0 };
+        alignas(64) std::atomic<size_t> _dequeuePos { 0 };
+    };
+}
+
+#endif // defined(__RGPUtils__LogRingBuffer_H__) header guard
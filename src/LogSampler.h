@@ -0,0 +1,121 @@
+/*
+ RGPUtils
+ LogSampler.h
+
+ Decides which debug and trace messages are kept when sampling is enabled
+ (see LogSamplingPolicy). Keeping 1 in N messages uses a shared counter,
+ the probabilistic sampling uses a xorshift generator of the calling thread,
+ so the decision never takes a lock.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogSampler_H__
+#define __RGPUtils__LogSampler_H__
+
+#include <rgp/Log.h>
+
+#include "LogTimestamp.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace rgp {
+
+    class LogSampler {
+
+    public:
+        LogSampler () {}
+
+        LogSampler (const LogSampler &) = delete;
+        LogSampler &operator = (const LogSampler &) = delete;
+
+        // takes over the values of a policy
+        void setPolicy (const LogSamplingPolicy &policy)
+        {
+            uint64_t threshold = UINT64_MAX;
+            if (policy.probability <= 0.0) {
+                threshold = 0;
+            } else if (policy.probability < 1.0) {
+                threshold = (uint64_t)(policy.probability * 18446744073709551616.0);
+            }
+
+            _every.store(policy.every > 1 ? policy.every : 1,
+                         std::memory_order_relaxed);
+            _threshold.store(threshold, std::memory_order_relaxed);
+        }
+
+        // true if the sampler drops any messages
+        bool isActive () const
+        {
+            return _every.load(std::memory_order_relaxed) > 1 ||
+                   _threshold.load(std::memory_order_relaxed) != UINT64_MAX;
+        }
+
+        // true if the next message should be kept
+        bool keep ()
+        {
+            uint32_t every = _every.load(std::memory_order_relaxed);
+            if (every > 1 &&
+                _counter.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+                return false;
+            }
+
+            uint64_t threshold = _threshold.load(std::memory_order_relaxed);
+            return threshold == UINT64_MAX || nextRandom() < threshold;
+        }
+
+    private:
+        // the counter is written by every logging thread, keep it on its own
+        // cache line, away from the values that are only read
+        alignas(64) std::atomic<uint64_t> _counter { 0 };
+
+        // keep 1 of every messages
+        alignas(64) std::atomic<uint32_t> _every { 1 };
+
+        // keep a message if a random number is below (UINT64_MAX keeps all)
+        std::atomic<uint64_t> _threshold { UINT64_MAX };
+
+        // xorshift64* of the calling thread
+        static uint64_t nextRandom ()
+        {
+            static thread_local uint64_t state = 0;
+
+            // seeded with the address of the state (differs per thread) and
+            // the time, mixed with splitmix64
+            if (state == 0) {
+                uint64_t seed = (uint64_t)(uintptr_t)&state ^
+                                (uint64_t)LogTimestamp::now();
+                seed += 0x9E3779B97F4A7C15ULL;
+                seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+                seed ^= seed >> 31;
+                state = seed != 0 ? seed : 1;
+            }
+
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 0x2545F4914F6CDD1DULL;
+        }
+    };
+}
+
+#endif // defined(__RGPUtils__LogSampler_H__) header guard
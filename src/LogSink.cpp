@@ -0,0 +1,308 @@
+/*
+ RGPUtils
+ LogSink.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include <rgp/LogSink.h>
+
+#include "LogConsole.h"
+#include "LogFile.h"
+#include "LogMappedFile.h"
+#include "LogUringFile.h"
+
+#include <cstring>  // strncpy
+#include <iostream> // cout / cerr
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif // !defined(_WIN32)
+
+using namespace rgp;
+
+// LogConsoleSink
+
+LogConsoleSink::LogConsoleSink (const bool useAnsiSgrCodes, const Loglevel level)
+: LogSink(level), _colorOutput(useAnsiSgrCodes && isLogConsoleTerminal(false)),
+  _colorError(useAnsiSgrCodes && isLogConsoleTerminal(true))
+{
+}
+
+void LogConsoleSink::write (const LogSinkRecord &record)
+{
+    bool isError = record.level == LoglevelError;
+
+    _line.clear();
+    appendLogConsoleLine(_line, record.message, record.messageSize,
+                         record.fgcolor, record.bgcolor,
+                         isError ? _colorError : _colorOutput);
+
+    writeLogConsole(isError, _line.data(), _line.size());
+}
+
+void LogConsoleSink::flush ()
+{
+    std::cout.flush();
+    std::cerr.flush();
+}
+
+// LogFileSink
+
+LogFileSink::LogFileSink (const std::string &path, const LogFlushPolicy &policy,
+                          const Loglevel level)
+: LogSink(level), _file(new LogFile())
+{
+    _file->setFlushPolicy(policy);
+
+    if (!_file->open(path)) {
+        throw LogException("can't open logfile " + path);
+    }
+}
+
+LogFileSink::~LogFileSink ()
+{
+}
+
+void LogFileSink::write (const LogSinkRecord &record)
+{
+    _file->append(record.line, record.lineSize);
+    _file->endLine(record.level == LoglevelError);
+}
+
+void LogFileSink::flush ()
+{
+    _file->flush();
+}
+
+void LogFileSink::flushIfDue ()
+{
+    _file->flushIfDue();
+}
+
+void LogFileSink::beginBatch ()
+{
+    _file->beginBatch();
+}
+
+void LogFileSink::endBatch ()
+{
+    _file->endBatch();
+}
+
+// LogUringFileSink
+
+LogUringFileSink::LogUringFileSink (const std::string &path,
+                                    const size_t bufferSize,
+                                    const size_t bufferCount,
+                                    const Loglevel level)
+: LogSink(level), _file(new LogUringFile())
+{
+    if (!_file->open(path, bufferSize, bufferCount)) {
+        throw LogException("can't open logfile " + path);
+    }
+}
+
+LogUringFileSink::~LogUringFileSink ()
+{
+}
+
+void LogUringFileSink::write (const LogSinkRecord &record)
+{
+    _file->append(record.line, record.lineSize);
+
+    // a batch is submitted as a whole by endBatch()
+    if (!_batching) {
+        _file->submit();
+    }
+}
+
+void LogUringFileSink::flush ()
+{
+    _file->flush();
+}
+
+void LogUringFileSink::flushIfDue ()
+{
+    _file->submit();
+}
+
+void LogUringFileSink::beginBatch ()
+{
+    _batching = true;
+}
+
+void LogUringFileSink::endBatch ()
+{
+    _batching = false;
+    _file->submit();
+}
+
+bool LogUringFileSink::usesIoUring () const
+{
+    return _file->usesIoUring();
+}
+
+// LogMappedFileSink
+
+LogMappedFileSink::LogMappedFileSink (const std::string &path,
+                                      const size_t segmentSize,
+                                      const Loglevel level)
+: LogSink(level), _file(new LogMappedFile())
+{
+    if (!LogMappedFile::isSupported()) {
+        throw LogException("memory mapped logfiles are not supported");
+    }
+
+    if (!_file->open(path, segmentSize)) {
+        throw LogException("can't create memory mapped logfile " + path);
+    }
+}
+
+LogMappedFileSink::~LogMappedFileSink ()
+{
+}
+
+void LogMappedFileSink::write (const LogSinkRecord &record)
+{
+    _file->write(record.line, record.lineSize);
+}
+
+// LogSocketSink
+
+#if defined(_WIN32)
+
+LogSocketSink::LogSocketSink (const std::string &, const std::string &,
+                              const Loglevel level)
+: LogSink(level)
+{
+    throw LogException("unix sockets are not supported");
+}
+
+LogSocketSink::~LogSocketSink ()
+{
+}
+
+void LogSocketSink::write (const LogSinkRecord &)
+{
+}
+
+#else
+
+LogSocketSink::LogSocketSink (const std::string &socketPath,
+                              const std::string &identifier,
+                              const Loglevel level)
+: LogSink(level), _identifier(identifier)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw LogException("socket path too long: " + socketPath);
+    }
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    _socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (_socket < 0) {
+        throw LogException("can't create socket");
+    }
+
+    if (connect(_socket, (sockaddr *)&address, sizeof(address)) != 0) {
+        ::close(_socket);
+        throw LogException("can't connect to " + socketPath);
+    }
+}
+
+LogSocketSink::~LogSocketSink ()
+{
+    ::close(_socket);
+}
+
+void LogSocketSink::write (const LogSinkRecord &record)
+{
+    // syslog severities of the loglevels
+    int severity = 7; // debug
+    switch (record.level) {
+        case LoglevelError: severity = 3; break;
+        case LoglevelWarning: severity = 4; break;
+        case LoglevelInfo: severity = 6; break;
+        default: break;
+    }
+
+    // facility user (1)
+    int priority = 1 * 8 + severity;
+
+    _datagram.clear();
+    _datagram.push_back('<');
+    _datagram.append(std::to_string(priority));
+    _datagram.push_back('>');
+    if (!_identifier.empty()) {
+        _datagram.append(_identifier);
+        _datagram.append(": ");
+    }
+    _datagram.append(record.message, record.messageSize);
+
+    // never block the application if the daemon is too slow
+    int flags = MSG_DONTWAIT;
+#if defined(MSG_NOSIGNAL)
+    flags |= MSG_NOSIGNAL;
+#endif // defined(MSG_NOSIGNAL)
+    send(_socket, _datagram.data(), _datagram.size(), flags);
+}
+
+#endif // defined(_WIN32)
+
+// LogMemorySink
+
+LogMemorySink::LogMemorySink (const size_t capacity, const Loglevel level)
+: LogSink(level), _capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+void LogMemorySink::write (const LogSinkRecord &record)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // reuse the memory of the oldest line
+    std::string line;
+    if (_lines.size() >= _capacity) {
+        line.swap(_lines.front());
+        _lines.pop_front();
+    }
+
+    // without the newline
+    line.assign(record.line, record.lineSize > 0 ? record.lineSize - 1 : 0);
+    _lines.push_back(std::move(line));
+}
+
+std::vector<std::string> LogMemorySink::lines () const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::vector<std::string> { _lines.begin(), _lines.end() };
+}
+
+void LogMemorySink::clear ()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _lines.clear();
+}
@@ -0,0 +1,50 @@
+/*
+ RGPUtils
+ LogThreadBuffer.h
+
+ Staging buffer of a single logging thread. Formatted lines are collected
+ here and handed to the output as one chunk.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogThreadBuffer_H__
+#define __RGPUtils__LogThreadBuffer_H__
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace rgp {
+
+    struct LogThreadBuffer {
+
+        // only contended while the flush thread or flush() takes the data
+        std::mutex mutex;
+
+        // formatted lines that were not handed to the output yet
+        std::string data;
+
+        // time of the first line in data
+        std::chrono::steady_clock::time_point since;
+    };
+}
+
+#endif // defined(__RGPUtils__LogThreadBuffer_H__) header guard
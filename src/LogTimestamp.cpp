@@ -0,0 +1,191 @@
+/*
+ RGPUtils
+ LogTimestamp.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LogTimestamp.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>   // snprintf
+#include <cstring>  // memcpy
+#include <ctime>    // localtime_r / gmtime_r
+
+using namespace rgp;
+
+static const int64_t kNanosecondsPerSecond = 1000000000;
+
+static int64_t steadyNanoseconds ()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t realtimeNanoseconds ()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// difference between the realtime clock and the monotonic clock
+static std::atomic<int64_t> clockOffset { 0 };
+
+// monotonic time of the next synchronization of clockOffset
+static std::atomic<int64_t> nextClockSync { 0 };
+
+int64_t LogTimestamp::now ()
+{
+    int64_t steady = steadyNanoseconds();
+
+    if (steady >= nextClockSync.load(std::memory_order_relaxed)) {
+
+        // only one thread has to synchronize, all others keep the old offset
+        int64_t expected = nextClockSync.load(std::memory_order_relaxed);
+        if (steady >= expected &&
+            nextClockSync.compare_exchange_strong(expected,
+                                                  steady + kNanosecondsPerSecond)) {
+            clockOffset.store(realtimeNanoseconds() - steady,
+                              std::memory_order_relaxed);
+        }
+    }
+
+    int64_t offset = clockOffset.load(std::memory_order_relaxed);
+    if (offset == 0) {
+        // another thread is doing the very first synchronization
+        return realtimeNanoseconds();
+    }
+
+    return steady + offset;
+}
+
+// the formatted date and time of the last second this thread has seen
+struct TimestampCache {
+    int64_t second { -1 };
+    char text[LogTimestamp::kMaxLength];
+    size_t length { 0 };
+};
+
+static thread_local TimestampCache timestampCache;
+static thread_local TimestampCache isoTimestampCache;
+
+// appends the fractional seconds of the precision, returns the new length
+static size_t appendFraction (char *buffer, size_t length, const int64_t timestamp,
+                              const LogTimestampPrecision precision)
+{
+    int64_t fraction = timestamp % kNanosecondsPerSecond;
+
+    int digits = 0;
+    int64_t divisor = kNanosecondsPerSecond;
+    switch (precision) {
+        case LogTimestampPrecisionMilliseconds: digits = 3; break;
+        case LogTimestampPrecisionMicroseconds: digits = 6; break;
+        default: break;
+    }
+
+    if (digits > 0) {
+        buffer[length++] = '.';
+        for (int i = 0; i < digits; i++) {
+            divisor /= 10;
+            buffer[length++] = (char)('0' + (fraction / divisor) % 10);
+        }
+    }
+
+    return length;
+}
+
+size_t LogTimestamp::format (char *buffer, const int64_t timestamp,
+                             const LogTimestampPrecision precision)
+{
+    int64_t second = timestamp / kNanosecondsPerSecond;
+
+    TimestampCache &cache = timestampCache;
+
+    if (cache.second != second) {
+
+        time_t time = (time_t)second;
+        tm current_time;
+#if defined(_WIN32)
+        localtime_s(&current_time, &time);
+#else
+        localtime_r(&time, &current_time);
+#endif // defined(_WIN32)
+
+        int length = snprintf(cache.text, sizeof(cache.text),
+                              "%d-%d-%d %d:%d:%d",
+                              current_time.tm_year + 1900,
+                              current_time.tm_mon + 1,
+                              current_time.tm_mday,
+                              current_time.tm_hour,
+                              current_time.tm_min,
+                              current_time.tm_sec);
+
+        cache.length = length > 0 ? (size_t)length : 0;
+        cache.second = second;
+    }
+
+    memcpy(buffer, cache.text, cache.length);
+
+    // append fractional seconds without formatting the rest again
+    size_t length = appendFraction(buffer, cache.length, timestamp, precision);
+
+    buffer[length++] = ' ';
+
+    return length;
+}
+
+size_t LogTimestamp::formatIso8601 (char *buffer, const int64_t timestamp,
+                                    const LogTimestampPrecision precision)
+{
+    int64_t second = timestamp / kNanosecondsPerSecond;
+
+    TimestampCache &cache = isoTimestampCache;
+
+    if (cache.second != second) {
+
+        time_t time = (time_t)second;
+        tm current_time;
+#if defined(_WIN32)
+        gmtime_s(&current_time, &time);
+#else
+        gmtime_r(&time, &current_time);
+#endif // defined(_WIN32)
+
+        int length = snprintf(cache.text, sizeof(cache.text),
+                              "%04d-%02d-%02dT%02d:%02d:%02d",
+                              current_time.tm_year + 1900,
+                              current_time.tm_mon + 1,
+                              current_time.tm_mday,
+                              current_time.tm_hour,
+                              current_time.tm_min,
+                              current_time.tm_sec);
+
+        cache.length = length > 0 ? (size_t)length : 0;
+        cache.second = second;
+    }
+
+    memcpy(buffer, cache.text, cache.length);
+
+    size_t length = appendFraction(buffer, cache.length, timestamp, precision);
+    buffer[length++] = 'Z';
+
+    return length;
+}
@@ -0,0 +1,71 @@
+/*
+ RGPUtils
+ LogTimestamp.h
+
+ Clock and cached timestamp formatting for the logfile prefix.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogTimestamp_H__
+#define __RGPUtils__LogTimestamp_H__
+
+#include <rgp/Log.h>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace rgp {
+
+    class LogTimestamp {
+
+    public:
+
+        // maximum length of a formatted timestamp (including the space)
+        static const size_t kMaxLength = 40;
+
+        /*
+         Current wall clock time in nanoseconds since the epoch. Derived from
+         the monotonic clock plus an offset to the realtime clock. The offset
+         is synchronized again once per second, so clock adjustments show up
+         with a delay of at most one second.
+         */
+        static int64_t now ();
+
+        /*
+         Writes "year-month-day hour:minute:second " (optionally with
+         fractional seconds) into the buffer (at least kMaxLength bytes) and
+         returns the length. The date and time part is cached per thread and
+         only formatted again when the second changes.
+         */
+        static size_t format (char *buffer, const int64_t timestamp,
+                              const LogTimestampPrecision precision);
+
+        /*
+         Writes the time in UTC as ISO 8601 ("2014-07-08T13:05:42.123Z")
+         into the buffer (at least kMaxLength bytes) and returns the length.
+         Cached per thread like format().
+         */
+        static size_t formatIso8601 (char *buffer, const int64_t timestamp,
+                                     const LogTimestampPrecision precision);
+    };
+}
+
+#endif // defined(__RGPUtils__LogTimestamp_H__) header guard
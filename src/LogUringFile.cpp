@@ -0,0 +1,690 @@
+/*
+ RGPUtils
+ LogUringFile.cpp
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LogUringFile.h"
+
+#include <algorithm> // std::min
+#include <cerrno>
+#include <cstring>   // memcpy / memset
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif // defined(_WIN32)
+
+// io_uring is used through the raw system calls (no liburing needed)
+#if defined(RGPUTILS_HAS_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif // defined(RGPUTILS_HAS_IO_URING)
+
+// at most this many buffers (the index of a registered buffer is 16 bit)
+static const size_t kMaxBufferCount = 1024;
+
+// small wrappers around the low level file functions of the platforms
+#if defined(_WIN32)
+static int openFile (const char *path, const bool append)
+{
+    return _open(path, _O_WRONLY | _O_CREAT | _O_BINARY |
+                 (append ? _O_APPEND : 0), _S_IREAD | _S_IWRITE);
+}
+
+static long writeFile (const int fd, const char *data, const size_t size)
+{
+    return _write(fd, data, (unsigned int)size);
+}
+
+static void closeFile (const int fd)
+{
+    _close(fd);
+}
+
+static uint64_t fileSize (const int fd)
+{
+    struct _stat64 info;
+    return _fstat64(fd, &info) == 0 ? (uint64_t)info.st_size : 0;
+}
+#else
+static int openFile (const char *path, const bool append)
+{
+    return ::open(path, O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : 0),
+                  0644);
+}
+
+static long writeFile (const int fd, const char *data, const size_t size)
+{
+    return ::write(fd, data, size);
+}
+
+static void closeFile (const int fd)
+{
+    ::close(fd);
+}
+
+static uint64_t fileSize (const int fd)
+{
+    struct stat info;
+    return fstat(fd, &info) == 0 ? (uint64_t)info.st_size : 0;
+}
+#endif // defined(_WIN32)
+
+// writes everything, retries after interruptions
+static void writeAll (const int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        long written = writeFile(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            // nothing we can do about it (we can't log the error)
+            return;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+using namespace rgp;
+
+#if defined(RGPUTILS_HAS_IO_URING)
+
+namespace rgp {
+
+    struct LogUringFile::Ring {
+
+        ~Ring () {
+            if (sqes != nullptr) {
+                munmap(sqes, sqesSize);
+            }
+            if (cqRing != MAP_FAILED && cqRing != sqRing) {
+                munmap(cqRing, cqRingSize);
+            }
+            if (sqRing != MAP_FAILED) {
+                munmap(sqRing, sqRingSize);
+            }
+            // also unregisters the buffers and the file
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+
+        int fd { -1 };
+
+        // the rings shared with the kernel (one mapping on newer kernels)
+        void *sqRing { MAP_FAILED };
+        size_t sqRingSize { 0 };
+        void *cqRing { MAP_FAILED };
+        size_t cqRingSize { 0 };
+        io_uring_sqe *sqes { nullptr };
+        size_t sqesSize { 0 };
+
+        unsigned *sqHead { nullptr };
+        unsigned *sqTail { nullptr };
+        unsigned *sqMask { nullptr };
+        unsigned *sqArray { nullptr };
+        unsigned *cqHead { nullptr };
+        unsigned *cqTail { nullptr };
+        unsigned *cqMask { nullptr };
+        io_uring_cqe *cqes { nullptr };
+
+        // the buffers / the file could be registered
+        bool fixedBuffers { false };
+        bool fixedFile { false };
+
+        // writes put into the queue but not submitted yet
+        unsigned pending { 0 };
+
+        // buffers owned by the kernel
+        size_t inFlight { 0 };
+    };
+}
+
+#else
+
+namespace rgp {
+
+    struct LogUringFile::Ring {
+        size_t inFlight { 0 };
+    };
+}
+
+#endif // defined(RGPUTILS_HAS_IO_URING)
+
+LogUringFile::LogUringFile ()
+{
+}
+
+LogUringFile::~LogUringFile ()
+{
+    close();
+}
+
+bool LogUringFile::open (const std::string &path, const size_t bufferSize,
+                         const size_t bufferCount)
+{
+    close();
+
+    _bufferSize = bufferSize > 0 ? bufferSize : 1;
+    _buffers = std::vector<Buffer>(std::min(std::max(bufferCount, (size_t)2),
+                                            kMaxBufferCount));
+    for (auto &buffer : _buffers) {
+        buffer.data.reset(new char[_bufferSize]);
+    }
+
+    // with io_uring the writes carry their file position, they may complete
+    // in any order (O_APPEND would ignore the position)
+    bool useRing = setupRing(_buffers.size());
+
+    _fd = openFile(path.c_str(), !useRing);
+    if (_fd < 0) {
+        _ring.reset();
+        _buffers.clear();
+        return false;
+    }
+
+    if (useRing) {
+        _offset = fileSize(_fd);
+        registerFile();
+    } else {
+        _stop = false;
+        _thread = std::thread(&LogUringFile::writerLoop, this);
+    }
+
+    return true;
+}
+
+void LogUringFile::close ()
+{
+    if (_fd < 0) {
+        return;
+    }
+
+    flush();
+
+    if (_ring) {
+        _ring.reset();
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _condition.notify_all();
+        _thread.join();
+    }
+
+    closeFile(_fd);
+    _fd = -1;
+    _buffers.clear();
+    _retiredBuffers.clear();
+    _current = -1;
+}
+
+bool LogUringFile::usesIoUring () const
+{
+    return _ring != nullptr;
+}
+
+void LogUringFile::append (const char *data, size_t size)
+{
+    if (_fd < 0) {
+        return;
+    }
+
+    // lines may span two buffers, the writes are in order anyway
+    while (size > 0) {
+
+        if (_current < 0) {
+            _current = (long)acquireBuffer();
+        }
+
+        Buffer &buffer = _buffers[_current];
+        size_t count = std::min(size, _bufferSize - buffer.used);
+        memcpy(buffer.data.get() + buffer.used, data, count);
+        buffer.used += count;
+        data += count;
+        size -= count;
+
+        if (buffer.used == _bufferSize) {
+            queueBuffer((size_t)_current);
+            _current = -1;
+        }
+    }
+}
+
+void LogUringFile::submit ()
+{
+    if (_fd < 0) {
+        return;
+    }
+
+    if (_current >= 0 && _buffers[_current].used > 0) {
+        queueBuffer((size_t)_current);
+        _current = -1;
+    }
+
+    // one system call submits everything and doesn't wait
+    if (_ring) {
+        if (enterRing(0)) {
+            reapCompletions();
+        } else {
+            breakRing();
+        }
+    }
+}
+
+void LogUringFile::flush ()
+{
+    if (_fd < 0) {
+        return;
+    }
+
+    submit();
+
+    while (_ring && _ring->inFlight > 0) {
+        if (!enterRing(1)) {
+            breakRing();
+            break;
+        }
+        reapCompletions();
+    }
+    if (_ring) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this] {
+        for (auto &buffer : _buffers) {
+            if (buffer.inFlight) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+// a buffer that isn't in flight (waits for one if necessary)
+size_t LogUringFile::acquireBuffer ()
+{
+    if (_ring) {
+        for (;;) {
+            for (size_t i = 0; i < _buffers.size(); i++) {
+                if (!_buffers[i].inFlight) {
+                    return i;
+                }
+            }
+            if (!enterRing(1)) {
+                breakRing();
+                break;
+            }
+            reapCompletions();
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        for (size_t i = 0; i < _buffers.size(); i++) {
+            if (!_buffers[i].inFlight) {
+                return i;
+            }
+        }
+        _condition.wait(lock);
+    }
+}
+
+// hands a filled buffer over
+void LogUringFile::queueBuffer (const size_t index)
+{
+    Buffer &buffer = _buffers[index];
+
+    if (_ring) {
+        buffer.offset = _offset;
+        buffer.written = 0;
+        buffer.inFlight = true;
+        _offset += buffer.used;
+        _ring->inFlight++;
+        prepareWrite(index);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        buffer.inFlight = true;
+        _queue.push_back(index);
+    }
+    _condition.notify_all();
+}
+
+// main loop of the writer thread
+void LogUringFile::writerLoop ()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (;;) {
+
+        _condition.wait(lock, [this] { return _stop || !_queue.empty(); });
+        if (_queue.empty()) {
+            break;
+        }
+
+        size_t index = _queue.front();
+        _queue.pop_front();
+        Buffer &buffer = _buffers[index];
+
+        lock.unlock();
+        writeAll(_fd, buffer.data.get(), buffer.used);
+        lock.lock();
+
+        buffer.used = 0;
+        buffer.inFlight = false;
+        _condition.notify_all();
+    }
+}
+
+#if defined(RGPUTILS_HAS_IO_URING)
+
+// writes everything at the given file position
+static void writeAllAt (const int fd, const char *data, size_t size,
+                        uint64_t offset)
+{
+    while (size > 0) {
+        long written = ::pwrite(fd, data, size, (off_t)offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        size -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+}
+
+// true if the kernel supports the operation (the probe needs kernel 5.6)
+static bool supportsOpcode (const int fd, const unsigned int opcode)
+{
+    static const unsigned int kProbeOps = 256;
+
+    std::unique_ptr<char[]> memory(new char[sizeof(io_uring_probe) +
+                                            kProbeOps * sizeof(io_uring_probe_op)]());
+    io_uring_probe *probe = (io_uring_probe *)memory.get();
+
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+                kProbeOps) != 0) {
+        return false;
+    }
+
+    return opcode <= probe->last_op &&
+           (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+
+// creates the io_uring instance and registers the buffers
+bool LogUringFile::setupRing (const size_t entries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // fails on kernels before 5.1 or if forbidden (f.e. by seccomp)
+    int fd = (int)syscall(__NR_io_uring_setup, (unsigned)entries, &params);
+    if (fd < 0) {
+        return false;
+    }
+
+    std::unique_ptr<Ring> ring(new Ring());
+    ring->fd = fd;
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes +
+                       params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) {
+        ring->sqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+        ring->cqRingSize = ring->sqRingSize;
+    }
+
+    ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED) {
+        return false;
+    }
+
+    if (singleMap) {
+        ring->cqRing = ring->sqRing;
+    } else {
+        ring->cqRing = mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED) {
+            return false;
+        }
+    }
+
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    ring->sqes = (io_uring_sqe *)sqes;
+
+    char *sq = (char *)ring->sqRing;
+    ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+
+    char *cq = (char *)ring->cqRing;
+    ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // registered buffers are pinned once instead of on every write, this
+    // may fail because of RLIMIT_MEMLOCK (plain writes are used then)
+    std::vector<iovec> iovecs(_buffers.size());
+    for (size_t i = 0; i < _buffers.size(); i++) {
+        iovecs[i].iov_base = _buffers[i].data.get();
+        iovecs[i].iov_len = _bufferSize;
+    }
+    ring->fixedBuffers = syscall(__NR_io_uring_register, fd,
+                                 IORING_REGISTER_BUFFERS, iovecs.data(),
+                                 (unsigned)iovecs.size()) == 0;
+
+    // WRITE_FIXED exists since kernel 5.1, IORING_OP_WRITE (for buffers that
+    // aren't registered) only since 5.6, older kernels would fail every
+    // write with -EINVAL
+    if (!ring->fixedBuffers && !supportsOpcode(fd, IORING_OP_WRITE)) {
+        return false;
+    }
+
+    _ring = std::move(ring);
+    return true;
+}
+
+// registers the opened file with the io_uring instance
+void LogUringFile::registerFile ()
+{
+    // a fixed file saves looking up the descriptor for every write
+    _ring->fixedFile = syscall(__NR_io_uring_register, _ring->fd,
+                               IORING_REGISTER_FILES, &_fd, 1) == 0;
+}
+
+// puts a write of the unwritten rest of a buffer into the queue
+void LogUringFile::prepareWrite (const size_t index)
+{
+    Ring &ring = *_ring;
+    Buffer &buffer = _buffers[index];
+
+    // only this thread writes the tail, at most one write per buffer is
+    // queued, so the queue (at least as large as the buffer count) never
+    // overflows
+    unsigned tail = *ring.sqTail;
+    unsigned slot = tail & *ring.sqMask;
+
+    io_uring_sqe &sqe = ring.sqes[slot];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = ring.fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    if (ring.fixedFile) {
+        sqe.fd = 0;
+        sqe.flags = IOSQE_FIXED_FILE;
+    } else {
+        sqe.fd = _fd;
+    }
+    sqe.addr = (uint64_t)(uintptr_t)(buffer.data.get() + buffer.written);
+    sqe.len = (uint32_t)(buffer.used - buffer.written);
+    sqe.off = buffer.offset + buffer.written;
+    if (ring.fixedBuffers) {
+        sqe.buf_index = (uint16_t)index;
+    }
+    sqe.user_data = index;
+
+    ring.sqArray[slot] = slot;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring.pending++;
+}
+
+// submits queued writes and waits for at least minComplete completions
+bool LogUringFile::enterRing (const unsigned int minComplete)
+{
+    Ring &ring = *_ring;
+
+    if (ring.pending == 0 && minComplete == 0) {
+        return true;
+    }
+
+    unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    for (;;) {
+        long result = syscall(__NR_io_uring_enter, ring.fd, ring.pending,
+                              minComplete, flags, nullptr, 0);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ring.pending -= (unsigned)result;
+        return true;
+    }
+}
+
+// handles the completed writes
+void LogUringFile::reapCompletions ()
+{
+    Ring &ring = *_ring;
+
+    unsigned head = *ring.cqHead;
+    unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+
+        io_uring_cqe &cqe = ring.cqes[head & *ring.cqMask];
+        size_t index = (size_t)cqe.user_data;
+        int result = cqe.res;
+        head++;
+
+        Buffer &buffer = _buffers[index];
+        if (result > 0) {
+            buffer.written += (size_t)result;
+        }
+
+        // short or interrupted write, the rest is written again
+        if ((result > 0 || result == -EINTR || result == -EAGAIN) &&
+            buffer.written < buffer.used) {
+            prepareWrite(index);
+            continue;
+        }
+
+        // written (or failed, we can't log the error)
+        buffer.used = 0;
+        buffer.inFlight = false;
+        ring.inFlight--;
+    }
+
+    __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+}
+
+// gives up io_uring and continues with the writer thread
+void LogUringFile::breakRing ()
+{
+    reapCompletions();
+
+    // the rest of every buffer in flight is written here, a write the kernel
+    // still performs writes the same bytes to the same position, so the
+    // memory must stay untouched (the buffer gets new memory)
+    for (auto &buffer : _buffers) {
+        if (!buffer.inFlight) {
+            continue;
+        }
+        writeAllAt(_fd, buffer.data.get() + buffer.written,
+                   buffer.used - buffer.written, buffer.offset + buffer.written);
+        _retiredBuffers.push_back(std::move(buffer.data));
+        buffer.data.reset(new char[_bufferSize]);
+        buffer.used = 0;
+        buffer.inFlight = false;
+    }
+
+    _ring.reset();
+
+    // io_uring wrote at explicit positions, the writer thread appends
+    ::lseek(_fd, (off_t)_offset, SEEK_SET);
+
+    _stop = false;
+    _thread = std::thread(&LogUringFile::writerLoop, this);
+}
+
+#else
+
+bool LogUringFile::setupRing (const size_t)
+{
+    return false;
+}
+
+void LogUringFile::registerFile ()
+{
+}
+
+void LogUringFile::prepareWrite (const size_t)
+{
+}
+
+bool LogUringFile::enterRing (const unsigned int)
+{
+    return false;
+}
+
+void LogUringFile::reapCompletions ()
+{
+}
+
+void LogUringFile::breakRing ()
+{
+}
+
+#endif // defined(RGPUTILS_HAS_IO_URING)
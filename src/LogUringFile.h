@@ -0,0 +1,155 @@
+/*
+ RGPUtils
+ LogUringFile.h
+
+ A logfile written through io_uring: lines are collected in a few large
+ buffers that are registered with the kernel, full buffers are submitted as
+ writes to a registered file without waiting for them. Falls back to a
+ writer thread if io_uring isn't available.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef __RGPUtils__LogUringFile_H__
+#define __RGPUtils__LogUringFile_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rgp {
+
+    /**
+     @brief A logfile with writes in flight.
+     @details Not thread-safe, the owning sink is serialized by the Log.
+     */
+    class LogUringFile {
+
+    public:
+        LogUringFile ();
+
+        // waits for all writes and closes the file
+        ~LogUringFile ();
+
+        LogUringFile (const LogUringFile &) = delete;
+        LogUringFile &operator = (const LogUringFile &) = delete;
+
+        // opens the file for appending and sets up io_uring (or the writer
+        // thread), returns false if the file can't be opened
+        bool open (const std::string &path, const size_t bufferSize,
+                   const size_t bufferCount);
+
+        // waits for all writes and closes the file
+        void close ();
+
+        // true if io_uring is used, false if the writer thread is used
+        bool usesIoUring () const;
+
+        // copies data into the current buffer, full buffers are queued
+        void append (const char *data, size_t size);
+
+        // queues the current buffer and hands all queued buffers to the
+        // kernel (or the writer thread) without waiting
+        void submit ();
+
+        // submits and waits until everything is written
+        void flush ();
+
+        // the io_uring instance
+        struct Ring;
+
+    private:
+        struct Buffer {
+            std::unique_ptr<char[]> data;
+
+            // bytes in the buffer
+            size_t used { 0 };
+
+            // file position and bytes already written (io_uring)
+            uint64_t offset { 0 };
+            size_t written { 0 };
+
+            // true while the kernel or the writer thread owns the buffer
+            // (protected by _mutex for the writer thread)
+            bool inFlight { false };
+        };
+
+        int _fd { -1 };
+        std::vector<Buffer> _buffers;
+        size_t _bufferSize { 0 };
+
+        // the buffer that is being filled (-1 = none)
+        long _current { -1 };
+
+        // the io_uring instance (null if the writer thread is used)
+        std::unique_ptr<Ring> _ring;
+
+        // memory of buffers the kernel may still read after io_uring was
+        // given up (kept until the file is closed)
+        std::vector<std::unique_ptr<char[]>> _retiredBuffers;
+
+        // file position of the next write (io_uring)
+        uint64_t _offset { 0 };
+
+        // the writer thread and the queued buffers
+        std::thread _thread;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::deque<size_t> _queue;
+        bool _stop { false };
+
+        // a buffer that isn't in flight (waits for one if necessary)
+        size_t acquireBuffer ();
+
+        // hands a filled buffer over
+        void queueBuffer (const size_t index);
+
+        // creates the io_uring instance and registers the buffers, returns
+        // false if io_uring isn't available
+        bool setupRing (const size_t entries);
+
+        // registers the opened file with the io_uring instance
+        void registerFile ();
+
+        // puts a write of the unwritten rest of a buffer into the queue
+        void prepareWrite (const size_t index);
+
+        // submits queued writes and waits for at least minComplete
+        // completions, returns false if io_uring failed
+        bool enterRing (const unsigned int minComplete);
+
+        // handles the completed writes
+        void reapCompletions ();
+
+        // gives up io_uring after a failed system call, writes the buffers
+        // in flight directly and starts the writer thread
+        void breakRing ();
+
+        // main loop of the writer thread
+        void writerLoop ();
+    };
+}
+
+#endif // defined(__RGPUtils__LogUringFile_H__) header guard
@@ -0,0 +1,155 @@
+/*
+ RGPUtils
+ log_allocations_test.cpp
+
+ Checks that a steady-state log call doesn't allocate: every scenario logs
+ through all text-taking methods until the reused buffers have grown, then
+ counts the heap allocations of the process (including the writer thread)
+ while logging the same calls again. Fails if any allocation happened.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+// compile in the RGPLOG*_FMT macros of all levels (also without DEBUG)
+#define RGP_LOG_COMPILE_LEVEL RGP_LOGLEVEL_TRACE
+
+#include <rgp/Log.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using namespace rgp;
+
+#if defined(_WIN32)
+static const char *kNullDevice = "NUL";
+#else
+static const char *kNullDevice = "/dev/null";
+#endif // defined(_WIN32)
+
+// calls per round, warm-up rounds and measured rounds
+static const int kCalls = 100;
+static const int kWarmupRounds = 50;
+static const int kMeasuredRounds = 20;
+
+// counts all heap allocations of the process
+static std::atomic<uint64_t> allocations { 0 };
+
+void *operator new (size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void *memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete (void *memory) noexcept
+{
+    free(memory);
+}
+
+// one round through the text-taking methods
+static void logRound (const std::string &message)
+{
+    Log *log = Log::sharedLog();
+
+    for (int i = 0; i < kCalls; i++) {
+        log->print(message, AnsiSgrFgColorGreen);
+        log->printv(message, AnsiSgrFgColorBlue, AnsiSgrBgColorWhite);
+        log->log(LoglevelWarning, "a warning as string literal");
+        log->error(message);
+        log->errorWithErrno("an error with errno", ENOENT);
+        log->error("an error with arguments: {} {} {}", "text", i, 0.25 * i);
+        RGPLOG_FMT("a call site with arguments: {} {} {}", "text", i, 0.25 * i);
+    }
+}
+
+// logs warm-up and measured rounds, returns false if the measured rounds
+// allocated
+static bool runScenario (const char *name)
+{
+    const std::string message { "a message with a typical length of about "
+                                "eighty characters for the test" };
+
+    for (int round = 0; round < kWarmupRounds; round++) {
+        logRound(message);
+        Log::sharedLog()->flush();
+    }
+
+    uint64_t before = allocations.load();
+
+    for (int round = 0; round < kMeasuredRounds; round++) {
+        logRound(message);
+        Log::sharedLog()->flush();
+    }
+
+    uint64_t allocated = allocations.load() - before;
+
+    fprintf(stderr, "%-16s %llu allocations\n", name,
+            (unsigned long long)allocated);
+
+    return allocated == 0;
+}
+
+int main ()
+{
+    Log *log = Log::sharedLog();
+    log->setLoglevel(LoglevelTrace);
+
+    bool passed = true;
+
+    // the console output with ANSI SGR codes (stdout goes to the null
+    // device, stderr is used for the results)
+    if (freopen(kNullDevice, "w", stdout) == nullptr) {
+        fprintf(stderr, "can't redirect stdout\n");
+        return EXIT_FAILURE;
+    }
+    log->useErrorfile(kNullDevice);
+    log->setUseAnsiSgrCodes(true, false);
+    passed = runScenario("console") && passed;
+    log->setUseAnsiSgrCodes(false);
+
+    // formatted lines written to logfiles
+    log->useLogfile(kNullDevice);
+    passed = runScenario("file") && passed;
+
+    // records circulating through the queue of the writer thread
+    log->setUseAsyncMode(true, 256);
+    passed = runScenario("async") && passed;
+    log->setUseAsyncMode(false);
+
+    // lines collected in the buffer of the thread
+    log->setThreadBufferSize(64 * 1024);
+    passed = runScenario("thread buffer") && passed;
+    log->setThreadBufferSize(0);
+
+    if (!passed) {
+        fprintf(stderr, "a steady-state log call allocated memory\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
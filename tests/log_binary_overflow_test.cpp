@@ -0,0 +1,127 @@
+/*
+ RGPUtils
+ log_binary_overflow_test.cpp
+
+ Checks that a binary logfile can still be decoded after the queue of the
+ asynchronous mode overflowed: several threads flood a small queue under
+ LogOverflowPolicyDropOldest through many call sites, so format definitions
+ are registered while events are dropped. The logfile is decoded with the
+ rgplog-decode tool (its path is the only argument). Fails if the tool
+ reports an error or a line refers to an unknown format.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include <rgp/Log.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif // defined(_WIN32)
+
+using namespace rgp;
+
+static const char *kLogfile = "log_binary_overflow_test.rgplog";
+
+// call sites, threads and calls per thread and site
+static const int kSites = 256;
+static const int kThreads = 4;
+static const int kCalls = 20;
+
+static LogSite sites[kSites];
+
+// logs through all sites, each one registers its format on first use
+static void flood (const int thread)
+{
+    Log *log = Log::sharedLog();
+
+    for (int call = 0; call < kCalls; call++) {
+        for (int site = 0; site < kSites; site++) {
+            log->log(sites[site], LoglevelDebug, "site {} thread {} call {} {}",
+                     site, thread, call, 0.5 * call);
+        }
+    }
+}
+
+int main (int argc, const char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <rgplog-decode>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Log *log = Log::sharedLog();
+    log->setLoglevel(LoglevelTrace);
+    log->useBinaryLogfile(kLogfile);
+    log->setAsyncOverflowPolicy(LogOverflowPolicyDropOldest);
+    log->setUseAsyncMode(true, 16);
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < kThreads; thread++) {
+        threads.emplace_back(flood, thread);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    log->flush();
+    log->setUseAsyncMode(false);
+    log->useBinaryLogfile("");
+
+    fprintf(stderr, "%llu messages dropped\n",
+            (unsigned long long)log->droppedMessages());
+
+    std::string command = std::string { argv[1] } + " " + kLogfile;
+    FILE *decoded = popen(command.c_str(), "r");
+    if (decoded == nullptr) {
+        fprintf(stderr, "can't run %s\n", command.c_str());
+        return EXIT_FAILURE;
+    }
+
+    char line[512];
+    size_t lines = 0;
+    size_t unknown = 0;
+    while (fgets(line, sizeof(line), decoded) != nullptr) {
+        lines++;
+        if (strstr(line, "<unknown format ") != nullptr) {
+            unknown++;
+        }
+    }
+
+    int status = pclose(decoded);
+    remove(kLogfile);
+
+    fprintf(stderr, "%zu lines decoded, %zu with an unknown format\n",
+            lines, unknown);
+
+    if (status != 0 || lines == 0 || unknown > 0) {
+        fprintf(stderr, "the binary logfile can't be decoded\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
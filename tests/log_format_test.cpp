@@ -0,0 +1,90 @@
+/*
+ RGPUtils
+ log_format_test.cpp
+
+ Checks that doubles in format strings are formatted exactly like
+ printf("%g"): known values whose rounding went wrong, values with three
+ decimals (many of them lie next to a tie after 6 significant digits) and
+ random values of the whole range. Fails on any mismatch.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include <rgp/LogFormat.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+using namespace rgp;
+
+// mismatches that are printed in detail
+static const int kMaxReported = 10;
+
+static int mismatches = 0;
+
+// compares the formatted value with snprintf
+static void check (const double value)
+{
+    char expected[32];
+    snprintf(expected, sizeof(expected), "%g", value);
+
+    std::string formatted;
+    LogArgument argument { value };
+    formatLogMessage(formatted, "{}", &argument, 1);
+
+    if (formatted != expected) {
+        if (mismatches < kMaxReported) {
+            fprintf(stderr, "%.17g: \"%s\" instead of \"%s\"\n",
+                    value, formatted.c_str(), expected);
+        }
+        mismatches++;
+    }
+}
+
+int main ()
+{
+    // known cases that were rounded in the wrong direction
+    const double known[] = {
+        1131.585, 4593.045, 1990.005, -1131.585, 0.5, 2.5, 0.125, 1e-4,
+        99999.95, 99999.5, 9.9999995, 0.00012345650000000001
+    };
+    for (double value : known) {
+        check(value);
+    }
+
+    // values with three decimals up to 2000
+    for (int value = 0; value < 2000000; value++) {
+        check(value / 1000.0);
+    }
+
+    // random values of the range with and without exponent
+    std::mt19937_64 generator { 42 };
+    std::uniform_real_distribution<double> exponents { -6.0, 7.0 };
+    for (int i = 0; i < 200000; i++) {
+        check(std::pow(10.0, exponents(generator)));
+    }
+
+    fprintf(stderr, "%d mismatches\n", mismatches);
+
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,130 @@
+/*
+ RGPUtils
+ log_rate_limit_test.cpp
+
+ Checks that the rate limit applies to format strings logged without a call
+ site: a burst through print() with arguments and through a LogCategory
+ must be limited per format string and summarized, a repeated message must
+ be suppressed as duplicate. Fails if more lines than the burst are written
+ or a summary is missing.
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include <rgp/Log.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+using namespace rgp;
+
+static const char *kLogfile = "log_rate_limit_test.log";
+static const char *kErrorfile = "log_rate_limit_test.err";
+
+// messages of a burst and the messages the bucket lets through
+static const int kMessages = 1000;
+static const unsigned int kBurst = 5;
+
+// number of lines of the file that contain the text
+static size_t countLines (const char *path, const std::string &text)
+{
+    std::ifstream file { path };
+    std::string line;
+    size_t count = 0;
+
+    while (std::getline(file, line)) {
+        if (line.find(text) != std::string::npos) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// checks the count of lines that contain the text
+static bool expectLines (const char *path, const std::string &text,
+                         const size_t minimum, const size_t maximum)
+{
+    size_t count = countLines(path, text);
+
+    fprintf(stderr, "%zu lines with \"%s\"\n", count, text.c_str());
+
+    if (count < minimum || count > maximum) {
+        fprintf(stderr, "expected %zu to %zu lines\n", minimum, maximum);
+        return false;
+    }
+    return true;
+}
+
+int main ()
+{
+    remove(kLogfile);
+    remove(kErrorfile);
+
+    Log *log = Log::sharedLog();
+    log->setLoglevel(LoglevelTrace);
+    log->useLogfile(kLogfile);
+    log->useErrorfile(kErrorfile);
+    log->setRateLimit(LogRateLimit(1, kBurst, 60));
+
+    LogCategory &network = log->category("network");
+    LogCategory &database = log->category("database");
+
+    // the token bucket of each format string (and category)
+    for (int i = 0; i < kMessages; i++) {
+        log->print("print {} of {}", i, kMessages);
+        log->error("error {} of {}", i, kMessages);
+        network.print("category {} of {}", i, kMessages);
+        database.print("category {} of {}", i, kMessages);
+    }
+
+    // the same arguments again are duplicates
+    for (int i = 0; i < kMessages; i++) {
+        log->print("duplicate {}", 42);
+    }
+
+    log->flush();
+
+    bool passed = true;
+
+    // one more line (and summary) may pass while the bucket refills
+    passed = expectLines(kLogfile, " print ", kBurst, kBurst + 1) && passed;
+    passed = expectLines(kErrorfile, " error ", kBurst, kBurst + 1) && passed;
+    passed = expectLines(kLogfile, "[network] category ", kBurst, kBurst + 1) && passed;
+    passed = expectLines(kLogfile, "[database] category ", kBurst, kBurst + 1) && passed;
+    passed = expectLines(kLogfile, "messages suppressed by the rate limit", 3, 6) && passed;
+    passed = expectLines(kErrorfile, "messages suppressed by the rate limit", 1, 2) && passed;
+    passed = expectLines(kLogfile, "duplicate 42", 1, 1) && passed;
+    passed = expectLines(kLogfile, "last message repeated", 1, 1) && passed;
+
+    log->useLogfile("");
+    log->useErrorfile("");
+    remove(kLogfile);
+    remove(kErrorfile);
+
+    if (!passed) {
+        fprintf(stderr, "format strings without a call site aren't limited\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,269 @@
+/*
+ RGPUtils
+ rgplog_decode.cpp
+
+ Decodes binary logfiles (see Log::useBinaryLogfile()) into text.
+
+ Usage: rgplog-decode [binary logfile]
+ Reads from stdin if no file is given. Errors are marked with "error: ".
+
+ -------------------------------------------------------------------------------
+ GNU Lesser General Public License Version 3, 29 June 2007
+
+ Copyright (c) 2014 Ralph-Gordon Paul. All rights reserved.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this library.
+ -------------------------------------------------------------------------------
+*/
+
+#include <rgp/LogFormat.h>
+
+#include "LogBinaryFormat.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace rgp;
+
+// reads binary data sequentially, remembers if the data was too short
+class Reader {
+
+public:
+    Reader (const std::string &data) : _data(data) {}
+
+    bool atEnd () const {
+        return _position >= _data.size();
+    };
+
+    bool failed () const {
+        return _failed;
+    };
+
+    bool startsWith (const char *bytes, const size_t size) const {
+        return _data.compare(_position, size, bytes, size) == 0;
+    };
+
+    void skip (const size_t size) {
+        _position += size;
+    };
+
+    template <typename T>
+    T read () {
+        T value {};
+        if (_position + sizeof(T) > _data.size()) {
+            _failed = true;
+            _position = _data.size();
+            return value;
+        }
+        memcpy(&value, _data.data() + _position, sizeof(T));
+        _position += sizeof(T);
+        return value;
+    };
+
+    // returns a pointer into the data (nullptr if it is too short)
+    const char *readBytes (const size_t size) {
+        if (_position + size > _data.size()) {
+            _failed = true;
+            _position = _data.size();
+            return nullptr;
+        }
+        const char *bytes = _data.data() + _position;
+        _position += size;
+        return bytes;
+    };
+
+private:
+    const std::string &_data;
+    size_t _position { 0 };
+    bool _failed { false };
+};
+
+// formats a timestamp like the text logfiles (with milliseconds)
+static std::string formatTimestamp (const int64_t timestamp)
+{
+    time_t seconds = (time_t)(timestamp / 1000000000);
+    int milliseconds = (int)((timestamp / 1000000) % 1000);
+
+    tm current_time;
+#if defined(_WIN32)
+    localtime_s(&current_time, &seconds);
+#else
+    localtime_r(&seconds, &current_time);
+#endif // defined(_WIN32)
+
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%d-%d-%d %d:%d:%d.%03d ",
+             current_time.tm_year + 1900,
+             current_time.tm_mon + 1,
+             current_time.tm_mday,
+             current_time.tm_hour,
+             current_time.tm_min,
+             current_time.tm_sec,
+             milliseconds);
+
+    return std::string { buffer };
+}
+
+// decodes one event, returns false if the data is corrupt
+static bool decodeEvent (Reader &reader,
+                         const std::map<uint32_t, std::string> &formats,
+                         std::string &line)
+{
+    uint32_t id = reader.read<uint32_t>();
+    int64_t timestamp = reader.read<int64_t>();
+    reader.read<uint8_t>(); // level
+    uint8_t flags = reader.read<uint8_t>();
+    uint8_t count = reader.read<uint8_t>();
+
+    std::vector<LogArgument> arguments;
+    arguments.reserve(count);
+
+    for (uint8_t i = 0; i < count && !reader.failed(); i++) {
+
+        switch (reader.read<uint8_t>()) {
+            case LogArgumentTypeInt: {
+                arguments.push_back(LogArgument((long long)reader.read<int64_t>()));
+            } break;
+
+            case LogArgumentTypeUInt: {
+                arguments.push_back(
+                    LogArgument((unsigned long long)reader.read<uint64_t>()));
+            } break;
+
+            case LogArgumentTypeDouble: {
+                arguments.push_back(LogArgument(reader.read<double>()));
+            } break;
+
+            case LogArgumentTypeBool: {
+                arguments.push_back(LogArgument(reader.read<uint8_t>() != 0));
+            } break;
+
+            case LogArgumentTypeChar: {
+                arguments.push_back(LogArgument((char)reader.read<uint8_t>()));
+            } break;
+
+            case LogArgumentTypeString: {
+                uint32_t size = reader.read<uint32_t>();
+                const char *data = reader.readBytes(size);
+                arguments.push_back(data != nullptr ? LogArgument(data, size)
+                                                    : LogArgument());
+            } break;
+
+            case LogArgumentTypePointer: {
+                arguments.push_back(LogArgument(
+                    (const void *)(uintptr_t)reader.read<uint64_t>()));
+            } break;
+
+            default:
+                return false;
+        }
+    }
+
+    if (reader.failed()) {
+        return false;
+    }
+
+    line = formatTimestamp(timestamp);
+    if (flags & kLogBinaryFlagError) {
+        line += "error: ";
+    }
+
+    auto format = formats.find(id);
+    if (format == formats.end()) {
+        line += "<unknown format ";
+        line += std::to_string(id);
+        line += ">";
+        return true;
+    }
+
+    formatLogMessage(line, format->second.c_str(),
+                     arguments.data(), arguments.size());
+    return true;
+}
+
+int main (int argc, const char **argv)
+{
+    if (argc > 2) {
+        std::cerr << "usage: " << argv[0] << " [binary logfile]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // read the whole file
+    std::string data;
+    if (argc == 2) {
+        std::ifstream file { argv[1], std::ios::binary };
+        if (!file.is_open()) {
+            std::cerr << "can't open " << argv[1] << std::endl;
+            return EXIT_FAILURE;
+        }
+        data.assign(std::istreambuf_iterator<char>(file),
+                    std::istreambuf_iterator<char>());
+    } else {
+        data.assign(std::istreambuf_iterator<char>(std::cin),
+                    std::istreambuf_iterator<char>());
+    }
+
+    Reader reader { data };
+    std::map<uint32_t, std::string> formats;
+    std::string line;
+
+    while (!reader.atEnd()) {
+
+        // a new session forgets all formats of the one before
+        if (reader.startsWith(kLogBinaryMagic, sizeof(kLogBinaryMagic))) {
+            reader.skip(sizeof(kLogBinaryMagic));
+            formats.clear();
+            continue;
+        }
+
+        char tag = reader.read<char>();
+
+        if (tag == kLogBinaryFormatTag) {
+
+            uint32_t id = reader.read<uint32_t>();
+            uint32_t size = reader.read<uint32_t>();
+            const char *format = reader.readBytes(size);
+            if (format == nullptr) {
+                break;
+            }
+            formats[id] = std::string { format, size };
+
+        } else if (tag == kLogBinaryEventTag) {
+
+            if (!decodeEvent(reader, formats, line)) {
+                break;
+            }
+            std::cout << line << '\n';
+
+        } else {
+            break;
+        }
+    }
+
+    std::cout.flush();
+
+    if (!reader.atEnd() || reader.failed()) {
+        std::cerr << "binary logfile is corrupt or truncated" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}